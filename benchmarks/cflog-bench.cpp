@@ -0,0 +1,429 @@
+/**
+ * @file cflog-bench.cpp
+ * @author Genleung Lan (genleung@hotmail.com)
+ * @brief cfLog的延迟与吞吐量测试
+ * @details 对每个(场景, 输出目标, 线程数)组合，让各线程同时调用若干次log语句，
+ * 逐次计时得到单次调用的延迟分位数(p50/p99/p99.9/max)，并给出总吞吐量与每次调用的堆分配次数;
+ * 结果以JSON Lines(默认)或CSV输出，每个组合一行
+ * @version 0.1
+ * @date 2021-07-31
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#define TRACE_ENABLED
+#define LOG_TAG "bench"
+#include "Log.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+using namespace cf::utils;
+
+namespace
+{
+    /// 本线程的堆分配次数(由下面替换的operator new累加)
+    thread_local uint64_t allocCount = 0;
+}
+
+void *operator new(size_t size)
+{
+    allocCount++;
+    void *p = std::malloc(size ? size : 1);
+    if (p == nullptr)
+        throw std::bad_alloc();
+    return p;
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept
+{
+    std::free(p);
+}
+
+namespace
+{
+    typedef std::chrono::steady_clock Clock;
+
+    /// 丢弃所有记录的输出目标，用于测量不含I/O的开销
+    class NullSink : public LogSink
+    {
+    public:
+        void write(LogLevel, const char *, size_t) override {}
+    };
+
+    /// 命令行选项
+    struct Options
+    {
+        std::vector<std::string> scenarios{"logi_const", "logi_format", "logi_stream", "filtered", "trace", "instances"};
+        std::vector<std::string> sinks{"null", "file"};
+        std::vector<int> threads;
+        size_t iterations = 100000;
+        std::string dir = ".";
+        std::string out;
+        bool csv = false;
+        bool async = false;
+    };
+
+    /// 一个组合的测试结果
+    struct Result
+    {
+        std::string scenario;
+        std::string sink;
+        int threads = 0;
+        uint64_t calls = 0;
+        double seconds = 0;
+        uint64_t p50 = 0, p99 = 0, p999 = 0, max = 0;
+        double allocsPerCall = 0;
+    };
+
+    std::vector<std::string> splitList(const std::string &s)
+    {
+        std::vector<std::string> items;
+        std::stringstream ss(s);
+        std::string item;
+        while (std::getline(ss, item, ','))
+        {
+            if (!item.empty())
+                items.push_back(item);
+        }
+        return items;
+    }
+
+    void usage(const char *prog)
+    {
+        std::cerr << "Usage: " << prog << " [options]\n"
+                  << "  --scenarios a,b,...  logi_const, logi_format, logi_stream, filtered, trace, instances\n"
+                  << "  --sinks a,b,...      null, file, stdout (default: null,file)\n"
+                  << "  --threads 1,2,4      producer thread counts (default: powers of two up to the core count)\n"
+                  << "  --iterations N       log calls per thread (default: 100000)\n"
+                  << "  --dir DIR            directory for the file sink (default: .)\n"
+                  << "  --out FILE           write results to FILE (default: stdout, or stderr with the stdout sink)\n"
+                  << "  --csv                CSV instead of JSON Lines\n"
+                  << "  --async              run the singleton Log in asynchronous mode\n";
+    }
+
+    bool parseOptions(int argc, char *argv[], Options &opt)
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            std::string arg = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (arg == "--scenarios" && hasValue)
+                opt.scenarios = splitList(argv[++i]);
+            else if (arg == "--sinks" && hasValue)
+                opt.sinks = splitList(argv[++i]);
+            else if (arg == "--threads" && hasValue)
+            {
+                for (auto &t : splitList(argv[++i]))
+                    opt.threads.push_back(std::max(1, std::atoi(t.c_str())));
+            }
+            else if (arg == "--iterations" && hasValue)
+                opt.iterations = std::max(1L, std::atol(argv[++i]));
+            else if (arg == "--dir" && hasValue)
+                opt.dir = argv[++i];
+            else if (arg == "--out" && hasValue)
+                opt.out = argv[++i];
+            else if (arg == "--csv")
+                opt.csv = true;
+            else if (arg == "--async")
+                opt.async = true;
+            else
+                return false;
+        }
+
+        if (opt.threads.empty())
+        {
+            int cores = std::max(1, (int)std::thread::hardware_concurrency());
+            for (int n = 1; n < cores; n *= 2)
+                opt.threads.push_back(n);
+            opt.threads.push_back(cores);
+        }
+        return true;
+    }
+
+    /**
+     * @brief 按名称创建输出目标
+     *
+     * @param[in] name null、file或stdout
+     * @param[in] file file目标使用的文件
+     */
+    std::shared_ptr<LogSink> makeSink(const std::string &name, const std::string &file)
+    {
+        if (name == "null")
+            return std::make_shared<NullSink>();
+        if (name == "stdout")
+            return ConsoleSink::instance();
+        if (name == "file")
+        {
+            std::remove(file.c_str());
+            return FileSink::open(file, false);
+        }
+        return nullptr;
+    }
+
+    /**
+     * @brief 单个场景中一个线程执行的一次log调用
+     *
+     * @param[in] scenario 场景编号(见scenarioIndex())
+     * @param[in] log "instances"场景中本线程独占的Log对象
+     * @param[in] i 调用序号
+     */
+    inline void logOnce(int scenario, Log *log, size_t i)
+    {
+        switch (scenario)
+        {
+        case 0:
+            LOGI("benchmark message without arguments");
+            break;
+        case 1:
+        case 3:
+            LOGI("value %zu, ratio %.3f, name %s", i, 0.5, "bench");
+            break;
+        case 2:
+            LOGI("value ") << i << ", ratio " << 0.5 << ", name " << "bench";
+            break;
+        case 4:
+            TRACEI("value %zu, ratio %.3f, name %s", i, 0.5, "bench");
+            break;
+        default:
+            (*log)(LogLevel::INFO, "bench") << "value " << i << ", ratio " << 0.5 << ", name " << "bench";
+            break;
+        }
+    }
+
+    int scenarioIndex(const std::string &name)
+    {
+        static const char *names[] = {"logi_const", "logi_format", "logi_stream", "filtered", "trace", "instances"};
+        for (int i = 0; i < (int)(sizeof(names) / sizeof(names[0])); i++)
+        {
+            if (name == names[i])
+                return i;
+        }
+        return -1;
+    }
+
+    uint64_t percentile(const std::vector<uint32_t> &sorted, double p)
+    {
+        size_t idx = (size_t)(p * (sorted.size() - 1) + 0.5);
+        return sorted[idx];
+    }
+
+    /**
+     * @brief 运行一个(场景, 输出目标, 线程数)组合
+     */
+    bool runCase(const Options &opt, const std::string &scenarioName, const std::string &sinkName, int threadCount, Result &res)
+    {
+        int scenario = scenarioIndex(scenarioName);
+        if (scenario < 0)
+            return false;
+
+        // 单例Log的输出目标与等级;"instances"场景中每个线程另有自己的Log对象与输出目标.
+        // 先释放上一组合的输出目标，否则FileSink::open()会返回仍被登记的(已删除的)同名文件
+        setLogSink(std::make_shared<NullSink>());
+        std::shared_ptr<LogSink> sink = makeSink(sinkName, opt.dir + "/cflog-bench.log");
+        if (!sink)
+            return false;
+        setLogSink(sink);
+        setLogLevel(scenario == 3 ? LogLevel::WARN : LogLevel::INFO);
+        enableLogPosition(scenario == 4, false);
+
+        std::vector<std::unique_ptr<Log>> logs(threadCount);
+        if (scenario == 5)
+        {
+            for (int t = 0; t < threadCount; t++)
+            {
+                logs[t].reset(new Log());
+                logs[t]->setLogSink(makeSink(sinkName, opt.dir + "/cflog-bench-" + std::to_string(t) + ".log"));
+            }
+        }
+
+        std::vector<std::vector<uint32_t>> latencies(threadCount, std::vector<uint32_t>(opt.iterations));
+        std::vector<uint64_t> allocs(threadCount);
+        std::atomic<int> ready{0};
+        std::atomic<bool> go{false};
+        std::vector<std::thread> workers;
+
+        for (int t = 0; t < threadCount; t++)
+        {
+            workers.emplace_back([&, t]()
+                                 {
+                                     std::vector<uint32_t> &lat = latencies[t];
+                                     Log *log = logs[t].get();
+                                     ready++;
+                                     while (!go.load(std::memory_order_acquire))
+                                         ;
+                                     uint64_t allocBefore = allocCount;
+                                     for (size_t i = 0; i < opt.iterations; i++)
+                                     {
+                                         Clock::time_point t0 = Clock::now();
+                                         logOnce(scenario, log, i);
+                                         Clock::time_point t1 = Clock::now();
+                                         lat[i] = (uint32_t)std::min<int64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count(), UINT32_MAX);
+                                     }
+                                     allocs[t] = allocCount - allocBefore;
+                                 });
+        }
+
+        while (ready.load() < threadCount)
+            std::this_thread::yield();
+        Clock::time_point start = Clock::now();
+        go.store(true, std::memory_order_release);
+        for (auto &w : workers)
+            w.join();
+        // 异步模式下吞吐量包含把队列中的记录写完所需的时间
+        flushLog();
+        for (auto &l : logs)
+        {
+            if (l)
+                l->flush();
+        }
+        Clock::time_point end = Clock::now();
+
+        std::vector<uint32_t> all;
+        all.reserve((size_t)threadCount * opt.iterations);
+        uint64_t allocTotal = 0;
+        for (int t = 0; t < threadCount; t++)
+        {
+            all.insert(all.end(), latencies[t].begin(), latencies[t].end());
+            allocTotal += allocs[t];
+        }
+        std::sort(all.begin(), all.end());
+
+        res.scenario = scenarioName;
+        res.sink = sinkName;
+        res.threads = threadCount;
+        res.calls = all.size();
+        res.seconds = std::chrono::duration<double>(end - start).count();
+        res.p50 = percentile(all, 0.50);
+        res.p99 = percentile(all, 0.99);
+        res.p999 = percentile(all, 0.999);
+        res.max = all.back();
+        res.allocsPerCall = (double)allocTotal / res.calls;
+        return true;
+    }
+
+    /// 两次连续读时钟的开销(纳秒)，已包含在每个延迟样本中
+    uint64_t timerOverhead()
+    {
+        std::vector<uint32_t> samples(100000);
+        for (auto &s : samples)
+        {
+            Clock::time_point t0 = Clock::now();
+            Clock::time_point t1 = Clock::now();
+            s = (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+        }
+        std::sort(samples.begin(), samples.end());
+        return percentile(samples, 0.50);
+    }
+
+    void printResult(std::ostream &os, const Options &opt, const Result &r, uint64_t overhead)
+    {
+        char line[512];
+        double throughput = r.seconds > 0 ? r.calls / r.seconds : 0;
+        if (opt.csv)
+        {
+            std::snprintf(line, sizeof(line), "%s,%s,%s,%d,%llu,%.6f,%.0f,%llu,%llu,%llu,%llu,%llu,%.3f",
+                          r.scenario.c_str(), r.sink.c_str(), opt.async ? "async" : "sync", r.threads,
+                          (unsigned long long)r.calls, r.seconds, throughput,
+                          (unsigned long long)r.p50, (unsigned long long)r.p99, (unsigned long long)r.p999,
+                          (unsigned long long)r.max, (unsigned long long)overhead, r.allocsPerCall);
+        }
+        else
+        {
+            std::snprintf(line, sizeof(line),
+                          "{\"scenario\":\"%s\",\"sink\":\"%s\",\"mode\":\"%s\",\"threads\":%d,\"calls\":%llu,"
+                          "\"seconds\":%.6f,\"calls_per_sec\":%.0f,\"p50_ns\":%llu,\"p99_ns\":%llu,\"p999_ns\":%llu,"
+                          "\"max_ns\":%llu,\"timer_overhead_ns\":%llu,\"allocs_per_call\":%.3f}",
+                          r.scenario.c_str(), r.sink.c_str(), opt.async ? "async" : "sync", r.threads,
+                          (unsigned long long)r.calls, r.seconds, throughput,
+                          (unsigned long long)r.p50, (unsigned long long)r.p99, (unsigned long long)r.p999,
+                          (unsigned long long)r.max, (unsigned long long)overhead, r.allocsPerCall);
+        }
+        os << line << std::endl;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    Options opt;
+    if (!parseOptions(argc, argv, opt))
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    // 输出到stdout的场景与结果混在一起时不便解析，此时结果改写到stderr
+    std::ofstream outFile;
+    std::ostream *os = &std::cout;
+    if (!opt.out.empty())
+    {
+        outFile.open(opt.out);
+        if (!outFile)
+        {
+            std::cerr << "Cannot open " << opt.out << std::endl;
+            return 1;
+        }
+        os = &outFile;
+    }
+    else if (std::find(opt.sinks.begin(), opt.sinks.end(), "stdout") != opt.sinks.end())
+    {
+        os = &std::cerr;
+    }
+
+    if (opt.async)
+        enableAsync(true);
+
+    uint64_t overhead = timerOverhead();
+    if (opt.csv)
+        *os << "scenario,sink,mode,threads,calls,seconds,calls_per_sec,p50_ns,p99_ns,p999_ns,max_ns,timer_overhead_ns,allocs_per_call" << std::endl;
+
+    for (auto &scenario : opt.scenarios)
+    {
+        for (auto &sink : opt.sinks)
+        {
+            for (int threads : opt.threads)
+            {
+                Result r;
+                if (!runCase(opt, scenario, sink, threads, r))
+                {
+                    std::cerr << "Unknown scenario or sink: " << scenario << "/" << sink << std::endl;
+                    return 1;
+                }
+                printResult(*os, opt, r, overhead);
+            }
+        }
+    }
+
+    setLogSink(ConsoleSink::instance());
+    return 0;
+}
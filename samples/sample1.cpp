@@ -29,7 +29,7 @@ int main(){
     LOGI("A")<<a<<":Hello!!!";
     setLogFile("log.txt", true);
     TRACEI("world!");
-    LOGE("")<<"error!";
+    LOGL(ERROR)<<"error!";
     setLogFile();
     LOGW("warn...");
     TRACEE("debug error");
@@ -0,0 +1,196 @@
+#include "AsyncWriter.h"
+#include "Log.h"
+#include <chrono>
+
+namespace cf
+{
+    namespace utils
+    {
+        AsyncWriter::AsyncWriter(Log *pLog, size_t capacity, OverflowPolicy policy, LogLevel urgentLevel)
+            : _pLog(pLog), _policy(policy), _queue(capacity), _urgent(capacity / 4 < 64 ? 64 : capacity / 4), _urgentLevel(urgentLevel)
+        {
+            _thread = std::thread(&AsyncWriter::run, this);
+        }
+
+        AsyncWriter::~AsyncWriter()
+        {
+            _stop.store(true);
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _wakeCond.notify_one();
+            }
+            if (_thread.joinable())
+                _thread.join();
+        }
+
+        bool AsyncWriter::push(const LogRecordView &rec)
+        {
+            // 拷贝到槽位中已有容量的字符串里，稳定状态下不产生堆分配
+            auto fill = [&](LogRecord &r)
+            {
+                r.level = rec.level;
+                r.text.assign(rec.text, rec.textLength);
+                r.text.append(rec.fields, rec.fieldsLength);
+                r.textLength = rec.textLength;
+                r.layout = rec.layout;
+            };
+
+            if (rec.level >= _urgentLevel)
+            {
+                // 紧急通道已满时不丢弃、也不等待，由调用线程直接写入
+                if (_urgent.tryPush(fill))
+                    wakeup();
+                else
+                    _pLog->write(rec);
+                return true;
+            }
+
+            while (!_queue.tryPush(fill))
+            {
+                if (_policy == OverflowPolicy::DROP_NEWEST)
+                {
+                    _dropped.fetch_add(1, std::memory_order_relaxed);
+                    return false;
+                }
+                else if (_policy == OverflowPolicy::DROP_OLDEST)
+                {
+                    // 生产者自己取走队首最旧的记录并丢弃之，再重试入队
+                    LogLevel level;
+                    if (_queue.tryPop([&](LogRecord &r) { level = r.level; }))
+                    {
+                        _dropped.fetch_add(1, std::memory_order_relaxed);
+                        _pLog->_stats.dropped(level);
+                    }
+                }
+                else
+                {
+                    // 阻塞策略: 让出CPU，等待后台写线程腾出空位
+                    wakeup();
+                    std::this_thread::yield();
+                }
+            }
+
+            wakeup();
+            return true;
+        }
+
+        void AsyncWriter::wakeup()
+        {
+            // 与run()中先置_sleeping再检查队列的顺序配合(均为seq_cst)，保证不会丢失唤醒
+            if (_sleeping.load())
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _wakeCond.notify_one();
+            }
+        }
+
+        void AsyncWriter::flush()
+        {
+            if (std::this_thread::get_id() == _thread.get_id())
+                return;
+
+            size_t target = _queue.enqueuePos();
+            size_t urgentTarget = _urgent.enqueuePos();
+            std::unique_lock<std::mutex> lock(_mutex);
+            _wakeCond.notify_one();
+            _doneCond.wait(lock, [&]()
+                           { return _written.load() >= target && _urgentWritten.load() >= urgentTarget; });
+        }
+
+        void AsyncWriter::writeRecord(const LogRecord &rec)
+        {
+            LogRecordView view;
+            view.level = rec.level;
+            view.text = rec.text.data();
+            view.textLength = rec.textLength;
+            view.fields = rec.text.data() + rec.textLength;
+            view.fieldsLength = rec.text.size() - rec.textLength;
+            view.layout = rec.layout;
+            _pLog->write(view);
+        }
+
+        void AsyncWriter::waitUrgent()
+        {
+            if (std::this_thread::get_id() == _thread.get_id())
+            {
+                // 后台写线程(例如输出目标中的FATAL记录)不能等待自己
+                LogRecord rec;
+                while (_urgent.tryPop([&](LogRecord &r)
+                                      {
+                                          rec.level = r.level;
+                                          rec.text.swap(r.text);
+                                          rec.textLength = r.textLength;
+                                          rec.layout = r.layout;
+                                      }))
+                    writeRecord(rec);
+                return;
+            }
+
+            size_t target = _urgent.enqueuePos();
+            std::unique_lock<std::mutex> lock(_mutex);
+            _wakeCond.notify_one();
+            _doneCond.wait(lock, [&]()
+                           { return _urgentWritten.load() >= target; });
+        }
+
+        void AsyncWriter::run()
+        {
+            LogRecord rec;
+            auto take = [&](LogRecord &r)
+            {
+                rec.level = r.level;
+                rec.text.swap(r.text);
+                rec.textLength = r.textLength;
+                rec.layout = r.layout;
+            };
+
+            for (;;)
+            {
+                bool wrote = false;
+                for (;;)
+                {
+                    // 每写一条普通记录之前，先写完紧急通道中的记录
+                    if (_urgent.tryPop(take))
+                    {
+                        do
+                        {
+                            writeRecord(rec);
+                        } while (_urgent.tryPop(take));
+                        wrote = true;
+
+                        // 立即公布紧急通道的进度: waitUrgent()不必等普通通道的积压写完
+                        _urgentWritten.store(_urgent.dequeuePos());
+                        std::lock_guard<std::mutex> lock(_mutex);
+                        _doneCond.notify_all();
+                    }
+                    if (!_queue.tryPop(take))
+                        break;
+                    writeRecord(rec);
+                    wrote = true;
+                }
+
+                if (wrote || _written.load() != _queue.dequeuePos() || _urgentWritten.load() != _urgent.dequeuePos())
+                {
+                    _urgentWritten.store(_urgent.dequeuePos());
+                    _written.store(_queue.dequeuePos());
+                    std::lock_guard<std::mutex> lock(_mutex);
+                    _doneCond.notify_all();
+                }
+
+                if (_stop.load() && _queue.empty() && _urgent.empty())
+                    break;
+
+                std::unique_lock<std::mutex> lock(_mutex);
+                _sleeping.store(true);
+                if (_queue.empty() && _urgent.empty() && !_stop.load())
+                    _wakeCond.wait_for(lock, std::chrono::milliseconds(100));
+                _sleeping.store(false);
+            }
+
+            _urgentWritten.store(_urgent.dequeuePos());
+            _written.store(_queue.dequeuePos());
+            std::lock_guard<std::mutex> lock(_mutex);
+            _doneCond.notify_all();
+        }
+    };
+};
@@ -0,0 +1,142 @@
+/**
+ * @file AsyncWriter.h
+ * @author Genleung Lan (genleung@hotmail.com)
+ * @brief 异步log写入后端
+ * @version 0.1
+ * @date 2021-07-31
+ * 
+ * @copyright Copyright (c) 2021
+ * 
+ */
+
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "LogFields.h"
+#include "RingBuffer.h"
+
+namespace cf
+{
+    namespace utils
+    {
+        enum class LogLevel;
+        class Log;
+
+        /**
+         * @brief 异步队列满时的处理策略.
+         * 
+         */
+        enum class OverflowPolicy : int
+        {
+            BLOCK = 0,   ///< 阻塞调用线程，直到队列有空位
+            DROP_NEWEST, ///< 丢弃当前(最新)的log记录
+            DROP_OLDEST  ///< 丢弃队列中最旧的log记录
+        };
+
+        /**
+         * @brief 异步队列中的一条log记录.
+         * @details 队列槽位中的记录被反复复用，text的容量在稳定状态下不再需要重新分配
+         */
+        struct LogRecord
+        {
+            LogLevel level; ///< log等级
+            std::string text; ///< 已格式化好的log信息(不含换行)，其后紧接编码后的键值字段
+            size_t textLength = 0;  ///< 文本部分的字节数
+            LogRecordLayout layout; ///< 前缀各部分的位置
+        };
+
+        /**
+         * @class cf::utils::AsyncWriter
+         * @brief 异步log写入器.
+         * @details 生产者线程仅把记录放入有界无锁队列(RingBuffer)，由一个后台写线程负责把记录写入Log的输出流.
+         * 不低于urgentLevel的记录进入单独的紧急通道: 后台写线程每写一条普通记录之前都先写完紧急通道中的记录，
+         * 因而大量INFO记录积压时WARN以上的记录也不必排在其后;紧急通道已满时由调用线程直接写入，从不丢弃.
+         * 溢出策略只作用于普通通道，即积压时首先被丢弃的总是低等级的记录.
+         * 不同通道的记录之间可能不按提交的先后顺序输出(可由时间戳还原)
+         * @warning 此类不允许被单独使用，仅能被Log类使用
+         */
+        class AsyncWriter
+        {
+        public:
+            /**
+             * @brief 构造函数，同时启动后台写线程
+             * 
+             * @param[in] pLog 所属的Log对象
+             * @param[in] capacity 队列容量
+             * @param[in] policy 普通通道满时的处理策略
+             * @param[in] urgentLevel 进入紧急通道的最低等级
+             */
+            AsyncWriter(Log *pLog, size_t capacity, OverflowPolicy policy, LogLevel urgentLevel);
+
+            /**
+             * @brief 析构函数，写完队列中剩余的记录后停止后台写线程
+             */
+            ~AsyncWriter();
+
+            AsyncWriter(const AsyncWriter &) = delete;
+            AsyncWriter &operator=(const AsyncWriter &) = delete;
+
+            /**
+             * @brief 把一条log记录放入队列.
+             * 
+             * @param[in] rec log记录(文本与字段均被拷贝)
+             * @return true 入队成功; false 记录因队列已满被丢弃
+             */
+            bool push(const LogRecordView &rec);
+
+            /**
+             * @brief 等待调用时刻之前入队的全部记录被写入输出流.
+             * 
+             */
+            void flush();
+
+            /**
+             * @brief 等待紧急通道中已提交的记录全部写完，不等待普通通道(供FATAL记录使用).
+             * @details 记录仍由后台写线程按顺序写出，因而不会有较早的紧急记录落在调用者随后直接写入的记录之后;
+             * 在后台写线程上调用时由其直接写完
+             */
+            void waitUrgent();
+
+            /**
+             * @brief 因队列溢出而被丢弃的记录数
+             */
+            uint64_t droppedCount() const { return _dropped.load(std::memory_order_relaxed); }
+
+        private:
+            /**
+             * @brief 后台写线程主循环
+             */
+            void run();
+
+            /**
+             * @brief 唤醒后台写线程(仅当其处于休眠状态时才需要加锁通知)
+             */
+            void wakeup();
+
+            /**
+             * @brief 把一条出队的记录写入Log的输出流
+             */
+            void writeRecord(const LogRecord &rec);
+
+        private:
+            Log *_pLog;                          ///< 所属Log对象
+            OverflowPolicy _policy;              ///< 队列满时的处理策略
+            RingBuffer<LogRecord> _queue;        ///< 普通通道
+            RingBuffer<LogRecord> _urgent;       ///< 紧急通道
+            LogLevel _urgentLevel;               ///< 进入紧急通道的最低等级
+            std::atomic<uint64_t> _dropped{0};   ///< 被丢弃的记录数
+            std::atomic<size_t> _written{0};     ///< 普通通道中已处理完毕(写入或丢弃)的出队序号
+            std::atomic<size_t> _urgentWritten{0}; ///< 紧急通道中已处理完毕的出队序号
+            std::atomic<bool> _sleeping{false};  ///< 后台写线程是否正在休眠
+            std::atomic<bool> _stop{false};      ///< 是否停止后台写线程
+            std::mutex _mutex;                   ///< 配合条件变量使用的互斥量
+            std::condition_variable _wakeCond;   ///< 唤醒后台写线程
+            std::condition_variable _doneCond;   ///< 通知flush()等待者
+            std::thread _thread;                 ///< 后台写线程
+        };
+    };
+};
@@ -0,0 +1,412 @@
+#include "BinaryLog.h"
+#include "Log.h"
+#include <algorithm>
+#include <chrono>
+
+namespace cf
+{
+    namespace utils
+    {
+        namespace
+        {
+            const char kMagic[8] = {'C', 'F', 'L', 'O', 'G', 'B', 'I', 'N'};
+            const uint32_t kVersion = 1;
+
+            /// 暂存缓冲区在_bufferSize之外多预留的字节数，容纳写满前的最后一条记录
+            const size_t kRecordSlack = 4096;
+
+            /// 后台线程写出各线程未满缓冲区的周期
+            const std::chrono::seconds kSweepInterval(1);
+
+            std::atomic<uint64_t> nextBinaryLogId{1};
+
+            /// 全局的调用点登记表，下标即编号(0号不使用)
+            struct SiteRegistry
+            {
+                std::mutex mutex;
+                std::vector<BinaryLogSite *> sites{nullptr};
+            };
+
+            SiteRegistry &siteRegistry()
+            {
+                static SiteRegistry r;
+                return r;
+            }
+
+            template <typename T>
+            bool get(std::istream &in, T &v)
+            {
+                return (bool)in.read((char *)&v, sizeof(v));
+            }
+
+            bool getString(std::istream &in, std::string &s, size_t len)
+            {
+                s.resize(len);
+                return len == 0 || (bool)in.read(&s[0], len);
+            }
+
+            /// 解码时使用的调用点定义
+            struct SiteInfo
+            {
+                LogLevel level = LogLevel::INFO;
+                int line = 0;
+                std::string tag;
+                std::string file;
+                std::string format;
+            };
+        }
+
+        BinaryLog::BinaryLog(const std::string &file, size_t bufferSize)
+            : _id(nextBinaryLogId++), _bufferSize(bufferSize)
+        {
+            _ofs.open(file, std::ios::out | std::ios::binary | std::ios::trunc);
+            std::string header(kMagic, sizeof(kMagic));
+            put(header, kVersion);
+            _ofs.write(header.data(), header.size());
+            _thread = std::thread(&BinaryLog::run, this);
+        }
+
+        BinaryLog::~BinaryLog()
+        {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _stop = true;
+                _wakeCond.notify_one();
+            }
+            if (_thread.joinable())
+                _thread.join();
+
+            drain(true);
+
+            std::vector<std::shared_ptr<Buffer>> buffers;
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                buffers.swap(_buffers);
+            }
+            for (auto &b : buffers)
+            {
+                std::lock_guard<std::mutex> bufLock(b->mutex);
+                b->closed = true;
+            }
+        }
+
+        uint32_t BinaryLog::registerSite(BinaryLogSite &site)
+        {
+            SiteRegistry &r = siteRegistry();
+            std::lock_guard<std::mutex> lock(r.mutex);
+            uint32_t id = site.id.load(std::memory_order_relaxed);
+            if (id == 0)
+            {
+                id = (uint32_t)r.sites.size();
+                r.sites.push_back(&site);
+                site.id.store(id, std::memory_order_release);
+            }
+            return id;
+        }
+
+        uint64_t BinaryLog::nowNs()
+        {
+            using namespace std::chrono;
+            return duration_cast<nanoseconds>(system_clock::now().time_since_epoch()).count();
+        }
+
+        BinaryLog::Buffer &BinaryLog::localBuffer()
+        {
+            // 线程局部登记表: 文件编号 -> 本线程在该文件中的暂存缓冲区
+            thread_local std::vector<std::pair<uint64_t, std::shared_ptr<Buffer>>> local;
+
+            for (auto &e : local)
+            {
+                if (e.first == _id)
+                    return *e.second;
+            }
+
+            // 顺便清理已销毁的BinaryLog留下的缓冲区
+            local.erase(std::remove_if(local.begin(), local.end(), [](const std::pair<uint64_t, std::shared_ptr<Buffer>> &e)
+                                       {
+                                           std::lock_guard<std::mutex> lock(e.second->mutex);
+                                           return e.second->closed; }),
+                        local.end());
+
+            std::shared_ptr<Buffer> buf = std::make_shared<Buffer>();
+            buf->bytes.reserve(_bufferSize + kRecordSlack);
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _buffers.push_back(buf);
+            }
+            local.emplace_back(_id, buf);
+            return *buf;
+        }
+
+        std::string &BinaryLog::beginRecord(Buffer &buf, uint32_t id)
+        {
+            // 记录的长度事先未知: 写满_bufferSize后再交付，缓冲区多预留kRecordSlack字节以免追加时重新分配
+            if (buf.bytes.size() >= _bufferSize)
+                handoff(buf);
+
+            if (id >= buf.defined.size() || !buf.defined[id])
+            {
+                // 本线程首次使用该调用点: 先写入其定义(同一线程的缓冲区按顺序写出，定义总在记录之前)
+                const BinaryLogSite *site;
+                {
+                    SiteRegistry &r = siteRegistry();
+                    std::lock_guard<std::mutex> regLock(r.mutex);
+                    site = r.sites[id];
+                }
+                uint16_t tagLen = (uint16_t)std::strlen(site->tag);
+                uint16_t fileLen = (uint16_t)std::strlen(site->file);
+                uint32_t fmtLen = (uint32_t)std::strlen(site->format);
+                buf.bytes.push_back('S');
+                put(buf.bytes, id);
+                put(buf.bytes, (uint8_t)site->level);
+                put(buf.bytes, (int32_t)site->line);
+                put(buf.bytes, tagLen);
+                buf.bytes.append(site->tag, tagLen);
+                put(buf.bytes, fileLen);
+                buf.bytes.append(site->file, fileLen);
+                put(buf.bytes, fmtLen);
+                buf.bytes.append(site->format, fmtLen);
+
+                if (id >= buf.defined.size())
+                    buf.defined.resize(id + 1, false);
+                buf.defined[id] = true;
+            }
+
+            return buf.bytes;
+        }
+
+        void BinaryLog::handoff(Buffer &buf)
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _full.emplace_back();
+            _full.back().swap(buf.bytes);
+            if (!_spare.empty())
+            {
+                buf.bytes.swap(_spare.back());
+                _spare.pop_back();
+            }
+            else
+            {
+                buf.bytes.reserve(_bufferSize + kRecordSlack);
+            }
+            _wakeCond.notify_one();
+        }
+
+        void BinaryLog::flush()
+        {
+            drain(true);
+        }
+
+        void BinaryLog::drain(bool all)
+        {
+            std::lock_guard<std::mutex> drainLock(_drainMutex);
+
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                for (auto &s : _full)
+                {
+                    _batch.emplace_back();
+                    _batch.back().swap(s);
+                }
+                _full.clear();
+                if (all)
+                    _snapshot = _buffers;
+            }
+
+            // 锁的顺序始终为: 线程缓冲区的互斥量 -> _mutex (与handoff()一致)
+            for (auto &p : _snapshot)
+            {
+                Buffer &b = *p;
+                std::lock_guard<std::mutex> bufLock(b.mutex);
+                if (b.bytes.empty())
+                    continue;
+
+                // 该线程在上面取走_full之后交付的块比它当前的缓冲区更早，须先写出
+                std::lock_guard<std::mutex> lock(_mutex);
+                for (auto &s : _full)
+                {
+                    _batch.emplace_back();
+                    _batch.back().swap(s);
+                }
+                _full.clear();
+                _batch.emplace_back();
+                _batch.back().swap(b.bytes);
+                if (!_spare.empty())
+                {
+                    b.bytes.swap(_spare.back());
+                    _spare.pop_back();
+                }
+            }
+            _snapshot.clear();
+
+            if (all)
+            {
+                // 线程已退出(仅剩本文件持有)且缓冲区已空: 不再需要登记
+                std::lock_guard<std::mutex> lock(_mutex);
+                _buffers.erase(std::remove_if(_buffers.begin(), _buffers.end(), [](const std::shared_ptr<Buffer> &p)
+                                              { return p.use_count() == 1 && p->bytes.empty(); }),
+                               _buffers.end());
+            }
+
+            if (_batch.empty())
+                return;
+
+            if (_ofs.is_open())
+            {
+                for (const std::string &s : _batch)
+                    _ofs.write(s.data(), s.size());
+                _ofs.flush();
+            }
+
+            std::lock_guard<std::mutex> lock(_mutex);
+            for (auto &s : _batch)
+            {
+                s.clear();
+                _spare.emplace_back();
+                _spare.back().swap(s);
+            }
+            _batch.clear();
+        }
+
+        void BinaryLog::run()
+        {
+            for (;;)
+            {
+                bool sweep;
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    sweep = !_wakeCond.wait_for(lock, kSweepInterval, [this]()
+                                                { return _stop || !_full.empty(); });
+                    if (_stop)
+                        break;
+                }
+                drain(sweep);
+            }
+        }
+
+        bool BinaryLog::decode(std::istream &in, std::ostream &out)
+        {
+            const static char *levelStr[] = {"[I]", "[N]", "[W]", "[E]", "[F]"};
+
+            char magic[sizeof(kMagic)];
+            uint32_t version = 0;
+            if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, kMagic, sizeof(kMagic)) != 0 || !get(in, version) || version != kVersion)
+                return false;
+
+            std::vector<SiteInfo> sites;
+            std::ostringstream line;
+            std::string str;
+            char type;
+            while (in.get(type))
+            {
+                if (type == 'S')
+                {
+                    uint32_t id;
+                    uint8_t level;
+                    int32_t srcLine;
+                    uint16_t tagLen, fileLen;
+                    uint32_t fmtLen;
+                    SiteInfo info;
+                    if (!get(in, id) || !get(in, level) || !get(in, srcLine) ||
+                        !get(in, tagLen) || !getString(in, info.tag, tagLen) ||
+                        !get(in, fileLen) || !getString(in, info.file, fileLen) ||
+                        !get(in, fmtLen) || !getString(in, info.format, fmtLen))
+                        return false;
+                    info.level = (LogLevel)(level < 5 ? level : 0);
+                    info.line = srcLine;
+                    if (id >= sites.size())
+                        sites.resize(id + 1);
+                    sites[id] = info;
+                }
+                else if (type == 'R')
+                {
+                    uint32_t id;
+                    uint64_t ts;
+                    uint8_t nargs;
+                    if (!get(in, id) || !get(in, ts) || !get(in, nargs) || id >= sites.size())
+                        return false;
+                    const SiteInfo &site = sites[id];
+
+                    line.str("");
+                    line << levelStr[(int)site.level];
+                    if (!site.tag.empty())
+                        line << "[" << site.tag << "]";
+                    char tbuf[LogTime::kMaxLength];
+                    size_t n = LogTime::formatAt(tbuf, TimeFormat::LOCAL, TimePrecision::MICROSECOND, (int64_t)ts);
+                    line << "[";
+                    line.write(tbuf, n);
+                    line << "]";
+                    std::string::size_type pos = site.file.find_last_of("/\\");
+                    line << "[" << site.file.substr(pos == std::string::npos ? 0 : pos + 1) << ":" << site.line << "] ";
+
+                    // 与LogFormat相同的规则把参数填入"{}"占位符
+                    std::streambuf *sb = line.rdbuf();
+                    const char *p = site.format.c_str();
+                    for (int i = 0; i < nargs; i++)
+                    {
+                        LogFormat::writeLiteral(sb, p);
+                        char tag;
+                        if (!in.get(tag))
+                            return false;
+                        switch (tag)
+                        {
+                        case 'b':
+                        case 'c':
+                        {
+                            char c;
+                            if (!in.get(c))
+                                return false;
+                            if (tag == 'b')
+                                LogFormat::writeValue(sb, line, c != 0);
+                            else
+                                LogFormat::writeValue(sb, line, c);
+                            break;
+                        }
+                        case 'i':
+                        {
+                            int64_t v;
+                            if (!get(in, v))
+                                return false;
+                            LogFormat::writeValue(sb, line, v);
+                            break;
+                        }
+                        case 'u':
+                        {
+                            uint64_t v;
+                            if (!get(in, v))
+                                return false;
+                            LogFormat::writeValue(sb, line, v);
+                            break;
+                        }
+                        case 'd':
+                        {
+                            double v;
+                            if (!get(in, v))
+                                return false;
+                            LogFormat::writeValue(sb, line, v);
+                            break;
+                        }
+                        case 's':
+                        {
+                            uint32_t len;
+                            if (!get(in, len) || !getString(in, str, len))
+                                return false;
+                            LogFormat::writeValue(sb, line, str);
+                            break;
+                        }
+                        default:
+                            return false;
+                        }
+                    }
+                    LogFormat::writeLiteral(sb, p);
+                    out << line.str() << '\n';
+                }
+                else
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+    };
+};
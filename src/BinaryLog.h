@@ -0,0 +1,277 @@
+/**
+ * @file BinaryLog.h
+ * @author Genleung Lan (genleung@hotmail.com)
+ * @brief 二进制(延迟格式化)log
+ * @version 0.1
+ * @date 2021-07-31
+ * 
+ * @copyright Copyright (c) 2021
+ * 
+ */
+
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "LogFormat.h"
+
+namespace cf
+{
+    namespace utils
+    {
+        enum class LogLevel;
+
+        /**
+         * @brief 二进制log的调用点信息.
+         * @details 每个LOG*_BIN宏展开处有一个静态的BinaryLogSite，首次使用时登记并获得全局唯一的编号;
+         * 此后每条记录只需写入该编号，格式字符串、文件名、行号等仅在每个log文件中写入一次
+         */
+        struct BinaryLogSite
+        {
+            constexpr BinaryLogSite(const char *fmt, const char *srcFile, int srcLine, LogLevel lv, const char *logTag)
+                : format(fmt), file(srcFile), line(srcLine), level(lv), tag(logTag), id(0)
+            {
+            }
+
+            const char *format;       ///< "{}"风格的格式字符串
+            const char *file;         ///< 源文件
+            int line;                 ///< 行号
+            LogLevel level;           ///< log等级
+            const char *tag;          ///< log标签
+            std::atomic<uint32_t> id; ///< 登记后的编号，0表示尚未登记
+        };
+
+        /**
+         * @class cf::utils::BinaryLog
+         * @brief 二进制log文件.
+         * @details 调用线程只写入调用点编号、时间戳与参数的原始字节，不做任何文本格式化;
+         * 文本由decode()(或cflog-decode工具)事后生成.
+         * 每个线程把记录追加到自己的暂存缓冲区(只有本线程与写文件线程会访问，几乎无竞争)，缓冲区写满后整块交给
+         * 后台线程写入文件，调用线程从不等待磁盘;后台线程每秒还会写出各线程未满的缓冲区.
+         * 同一线程的记录在文件中保持顺序，不同线程的记录按块交错(可按时间戳恢复全局顺序);
+         * 调用点定义写在每个线程首次使用它的记录之前，因此同一调用点的定义可能出现多次.
+         * 
+         * 文件格式(本机字节序):
+         * - 文件头: "CFLOGBIN" + u32版本号
+         * - 调用点定义: 'S' u32编号 u8等级 i32行号 u16+标签 u16+文件名 u32+格式字符串
+         * - 记录: 'R' u32编号 u64时间戳(Unix纳秒) u8参数个数 参数...
+         * - 参数: 'b'/'c' 1字节, 'i' i64, 'u' u64, 'd' double, 's' u32长度+字节
+         */
+        class BinaryLog
+        {
+        public:
+            /**
+             * @brief 构造函数，创建(截断)二进制log文件
+             * 
+             * @param[in] file 二进制log文件
+             * @param[in] bufferSize 每个线程暂存缓冲区的大小
+             */
+            explicit BinaryLog(const std::string &file, size_t bufferSize = 64 * 1024);
+
+            /**
+             * @brief 析构函数，停止后台线程，写出所有暂存的记录并关闭文件
+             */
+            ~BinaryLog();
+
+            BinaryLog(const BinaryLog &) = delete;
+            BinaryLog &operator=(const BinaryLog &) = delete;
+
+            /**
+             * @brief 文件是否已成功打开
+             */
+            bool isOpen() const { return _ofs.is_open(); }
+
+            /**
+             * @brief 写入一条二进制记录
+             * 
+             * @param[in] site 调用点
+             * @param[in] args 参数
+             */
+            template <typename... Args>
+            void write(BinaryLogSite &site, const FormatArgs<Args...> &args)
+            {
+                uint32_t id = site.id.load(std::memory_order_acquire);
+                if (id == 0)
+                    id = registerSite(site);
+                uint64_t ts = nowNs();
+
+                // 直接编码到调用线程的暂存缓冲区，稳定状态下不产生堆分配
+                Buffer &buf = localBuffer();
+                std::lock_guard<std::mutex> lock(buf.mutex);
+                std::string &rec = beginRecord(buf, id);
+                rec.push_back('R');
+                put(rec, id);
+                put(rec, ts);
+                rec.push_back((char)sizeof...(Args));
+                encodeArgs(rec, args.values(), std::index_sequence_for<Args...>());
+            }
+
+            /**
+             * @brief 把所有线程暂存的记录写入文件(在调用线程上完成)
+             */
+            void flush();
+
+            /**
+             * @brief 把二进制log解码为文本log
+             * 
+             * @param[in] in 二进制log输入流
+             * @param[out] out 文本输出流
+             * @return true 解码成功; false 文件格式有误(已解码的部分仍会输出)
+             */
+            static bool decode(std::istream &in, std::ostream &out);
+
+        private:
+            /**
+             * @brief 登记调用点，返回其全局编号
+             */
+            static uint32_t registerSite(BinaryLogSite &site);
+
+            /**
+             * @brief 当前时间(Unix纳秒)
+             */
+            static uint64_t nowNs();
+
+            /// 一个线程的暂存缓冲区
+            struct Buffer
+            {
+                std::mutex mutex;           ///< 本线程与写文件线程之间的互斥量
+                std::string bytes;          ///< 暂存的调用点定义与记录
+                std::vector<bool> defined;  ///< 本线程已写入定义的调用点编号
+                bool closed = false;        ///< 所属BinaryLog已销毁
+            };
+
+            /**
+             * @brief 获取调用线程在本文件中的暂存缓冲区(首次调用时创建并登记)
+             */
+            Buffer &localBuffer();
+
+            /**
+             * @brief 准备在暂存缓冲区中写入一条记录(已持有buf.mutex): 缓冲区已满时先交付，本线程首次使用该调用点时先写入其定义
+             *
+             * @return std::string& 记录应追加到的缓冲区
+             */
+            std::string &beginRecord(Buffer &buf, uint32_t id);
+
+            /**
+             * @brief 把写满的缓冲区内容交给后台线程，并换上一块空缓冲(已持有buf.mutex)
+             */
+            void handoff(Buffer &buf);
+
+            /**
+             * @brief 写出已交付的缓冲区;all为true时同时写出各线程未满的缓冲区
+             */
+            void drain(bool all);
+
+            /**
+             * @brief 后台线程主循环
+             */
+            void run();
+
+            template <typename T>
+            static void put(std::string &out, T v)
+            {
+                out.append((const char *)&v, sizeof(v));
+            }
+
+            static void putString(std::string &out, const char *s, size_t len)
+            {
+                out.push_back('s');
+                put(out, (uint32_t)len);
+                out.append(s, len);
+            }
+
+            template <typename Tuple, size_t... I>
+            static void encodeArgs(std::string &out, const Tuple &t, std::index_sequence<I...>)
+            {
+                int expand[] = {0, (encode(out, std::get<I>(t)), 0)...};
+                (void)expand;
+            }
+
+            static void encode(std::string &out, bool v)
+            {
+                out.push_back('b');
+                out.push_back((char)v);
+            }
+
+            static void encode(std::string &out, char v)
+            {
+                out.push_back('c');
+                out.push_back(v);
+            }
+
+            static void encode(std::string &out, const char *v)
+            {
+                if (v == nullptr)
+                    v = "(null)";
+                putString(out, v, std::strlen(v));
+            }
+
+            static void encode(std::string &out, const std::string &v)
+            {
+                putString(out, v.data(), v.size());
+            }
+
+            template <typename T>
+            static typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type
+            encode(std::string &out, T v)
+            {
+                out.push_back('i');
+                put(out, (int64_t)v);
+            }
+
+            template <typename T>
+            static typename std::enable_if<std::is_integral<T>::value && !std::is_signed<T>::value>::type
+            encode(std::string &out, T v)
+            {
+                out.push_back('u');
+                put(out, (uint64_t)v);
+            }
+
+            template <typename T>
+            static typename std::enable_if<std::is_floating_point<T>::value>::type
+            encode(std::string &out, T v)
+            {
+                out.push_back('d');
+                put(out, (double)v);
+            }
+
+            /// 其它类型: 只能在调用线程上用operator<<转为字符串
+            template <typename T>
+            static typename std::enable_if<!std::is_arithmetic<T>::value && !std::is_convertible<T, const char *>::value>::type
+            encode(std::string &out, const T &v)
+            {
+                std::ostringstream os;
+                os << v;
+                std::string s = os.str();
+                putString(out, s.data(), s.size());
+            }
+
+        private:
+            uint64_t _id;                                  ///< 唯一编号，用于线程局部登记表
+            size_t _bufferSize;                            ///< 暂存缓冲区大小
+            std::ofstream _ofs;                            ///< 二进制log文件(只在持有_drainMutex时写入)
+            std::mutex _mutex;                             ///< 保护_buffers/_full/_spare/_stop
+            std::vector<std::shared_ptr<Buffer>> _buffers; ///< 所有线程的暂存缓冲区
+            std::vector<std::string> _full;                ///< 已交付、待写出的缓冲区内容(按交付顺序)
+            std::vector<std::string> _spare;               ///< 可复用的空缓冲
+            std::mutex _drainMutex;                        ///< 保证同一时间只有一个线程在写文件
+            std::vector<std::shared_ptr<Buffer>> _snapshot; ///< 本次写出时各线程缓冲区的快照
+            std::vector<std::string> _batch;               ///< 本次写出的缓冲区内容
+            std::condition_variable _wakeCond;             ///< 唤醒后台线程
+            bool _stop = false;                            ///< 是否停止后台线程
+            std::thread _thread;                           ///< 后台线程
+        };
+    };
+};
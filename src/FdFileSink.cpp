@@ -0,0 +1,132 @@
+#include "FdFileSink.h"
+
+#if !defined(_WIN32) && !defined(_WIN64)
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace cf
+{
+    namespace utils
+    {
+        FdFileSink::FdFileSink(const std::string &file, bool append, size_t bufferSize, bool syncOnFlush)
+            : _syncOnFlush(syncOnFlush)
+        {
+            int flags = O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC;
+            if (!append)
+                flags |= O_TRUNC;
+            _fd = ::open(file.c_str(), flags, 0644);
+
+            _capacity = bufferSize;
+            void *p = nullptr;
+            if (posix_memalign(&p, 4096, _capacity) != 0)
+            {
+                p = nullptr;
+                _capacity = 0;
+            }
+            _buf = (char *)p;
+        }
+
+        FdFileSink::~FdFileSink()
+        {
+            if (_fd >= 0)
+            {
+                flushLocked();
+                if (_syncOnFlush)
+                    fdatasync(_fd);
+                ::close(_fd);
+            }
+            free(_buf);
+        }
+
+        void FdFileSink::write(LogLevel, const char *data, size_t len)
+        {
+            append(data, len, true);
+        }
+
+        void FdFileSink::writeBytes(LogLevel, const char *data, size_t len)
+        {
+            append(data, len, false);
+        }
+
+        void FdFileSink::append(const char *data, size_t len, bool newline)
+        {
+            std::unique_lock<std::mutex> lock = lockForWrite();
+            if (_fd < 0)
+                return;
+
+            size_t need = len + (newline ? 1 : 0);
+            if (_used + need > _capacity)
+            {
+                if (need > _capacity)
+                {
+                    // 超长记录: 与缓冲区中的内容一起，以一次writev()写出
+                    flushLocked(data, len, newline);
+                    return;
+                }
+                flushLocked();
+            }
+
+            std::memcpy(_buf + _used, data, len);
+            if (newline)
+                _buf[_used + len] = '\n';
+            _used += need;
+        }
+
+        void FdFileSink::flush()
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (_fd < 0)
+                return;
+            flushLocked();
+            if (_syncOnFlush)
+                fdatasync(_fd);
+        }
+
+        void FdFileSink::flushLocked(const char *data, size_t len, bool newline)
+        {
+            static char lf = '\n';
+            struct iovec iov[3];
+            int n = 0;
+            if (_used > 0)
+                iov[n++] = {_buf, _used};
+            if (data)
+            {
+                iov[n++] = {(void *)data, len};
+                if (newline)
+                    iov[n++] = {&lf, 1};
+            }
+
+            // O_APPEND保证每次write/writev整体追加到文件末尾;仅在被部分写入时才需要续写剩余部分
+            struct iovec *v = iov;
+            while (n > 0)
+            {
+                ssize_t w = ::writev(_fd, v, n);
+                if (w < 0)
+                {
+                    if (errno == EINTR)
+                        continue;
+                    break;
+                }
+                while (n > 0 && (size_t)w >= v->iov_len)
+                {
+                    w -= v->iov_len;
+                    v++;
+                    n--;
+                }
+                if (n > 0)
+                {
+                    v->iov_base = (char *)v->iov_base + w;
+                    v->iov_len -= w;
+                }
+            }
+            _used = 0;
+        }
+    };
+};
+
+#endif
@@ -0,0 +1,89 @@
+/**
+ * @file FdFileSink.h
+ * @author Genleung Lan (genleung@hotmail.com)
+ * @brief 直接基于文件描述符(O_APPEND)的log文件
+ * @version 0.1
+ * @date 2021-07-31
+ * 
+ * @copyright Copyright (c) 2021
+ * 
+ */
+
+#pragma once
+#include <string>
+#include "LogSink.h"
+
+#if !defined(_WIN32) && !defined(_WIN64)
+
+namespace cf
+{
+    namespace utils
+    {
+        /**
+         * @class cf::utils::FdFileSink
+         * @brief 以O_APPEND打开原始文件描述符的log文件(仅POSIX系统).
+         * @details 记录被累积到一块对齐的大缓冲区中，刷新时以一次write()/writev()写出;
+         * 缓冲区中只存放完整的记录，配合O_APPEND的原子追加语义，多个进程同时追加同一个文件时记录也不会相互交错.
+         * 不经过std::ofstream的缓冲与locale机制.
+         */
+        class FdFileSink : public LogSink
+        {
+        public:
+            /// 默认缓冲区大小
+            static const size_t kDefaultBufferSize = 64 * 1024;
+
+            /**
+             * @brief 构造函数
+             * 
+             * @param[in] file log文件
+             * @param[in] append 是否以追加模式打开(否则截断文件)
+             * @param[in] bufferSize 缓冲区大小
+             * @param[in] syncOnFlush 每次flush()后是否调用fdatasync()，使记录落盘
+             */
+            FdFileSink(const std::string &file, bool append = true, size_t bufferSize = kDefaultBufferSize, bool syncOnFlush = false);
+
+            /**
+             * @brief 析构函数，写出缓冲区中的记录并关闭文件
+             */
+            ~FdFileSink();
+
+            FdFileSink(const FdFileSink &) = delete;
+            FdFileSink &operator=(const FdFileSink &) = delete;
+
+            void write(LogLevel level, const char *data, size_t len) override;
+            void writeBytes(LogLevel level, const char *data, size_t len) override;
+            void flush() override;
+
+            /**
+             * @brief 文件是否已成功打开
+             */
+            bool isOpen() const { return _fd >= 0; }
+
+        private:
+            /**
+             * @brief 把一条记录追加到缓冲区(缓冲区放不下时先写出)
+             * 
+             * @param[in] newline 是否在记录后追加换行符
+             */
+            void append(const char *data, size_t len, bool newline);
+
+            /**
+             * @brief 在已持有_mutex时写出缓冲区，并可附带写出一条(放不进缓冲区的)记录
+             * 
+             * @param[in] data 附带写出的记录，可为空
+             * @param[in] len 附带写出的记录的字节数
+             * @param[in] newline 是否在附带的记录后写出换行符
+             */
+            void flushLocked(const char *data = nullptr, size_t len = 0, bool newline = true);
+
+        private:
+            int _fd = -1;             ///< 文件描述符
+            char *_buf = nullptr;     ///< 对齐的缓冲区
+            size_t _capacity = 0;     ///< 缓冲区大小
+            size_t _used = 0;         ///< 缓冲区中已使用的字节数
+            bool _syncOnFlush;        ///< flush()后是否fdatasync()
+        };
+    };
+};
+
+#endif
@@ -0,0 +1,377 @@
+#include "FlightRecorderSink.h"
+
+#if !defined(_WIN32) && !defined(_WIN64)
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
+
+namespace cf
+{
+    namespace utils
+    {
+        /**
+         * @details 记录在缓冲区中的格式为: 长度(4字节) + 线程号(4字节) + 记录 + 长度(4字节)，尾部的长度用于从最新的记录向前回溯;
+         * 线程号随每条记录保存，缓冲区被新线程接手后，已退出线程留下的记录仍标注为原来的线程.
+         * 写入前先推进reserved，写完后再推进committed: 读取者读完一条记录后检查reserved，
+         * 即可知道这条记录在读取期间是否已被覆盖
+         */
+        struct FlightRecorderSink::Ring
+        {
+            std::atomic<bool> owned{true};        ///< 是否有线程正在使用
+            std::atomic<uint64_t> reserved{0};    ///< 已预留(可能正在写入)的字节总数
+            std::atomic<uint64_t> committed{0};   ///< 已写完的字节总数
+            std::atomic<bool> closed{false};      ///< 所属记录仪已销毁
+            int32_t tid = 0;                      ///< 使用本缓冲区的线程(只由该线程读写)
+            size_t capacity = 0;                  ///< 缓冲区大小
+            std::unique_ptr<char[]> bytes;        ///< 缓冲区
+
+            void put(uint64_t pos, const void *src, size_t n)
+            {
+                size_t idx = (size_t)(pos % capacity);
+                size_t first = n < capacity - idx ? n : capacity - idx;
+                std::memcpy(bytes.get() + idx, src, first);
+                std::memcpy(bytes.get(), (const char *)src + first, n - first);
+            }
+
+            void get(uint64_t pos, void *dst, size_t n) const
+            {
+                size_t idx = (size_t)(pos % capacity);
+                size_t first = n < capacity - idx ? n : capacity - idx;
+                std::memcpy(dst, bytes.get() + idx, first);
+                std::memcpy((char *)dst + first, bytes.get(), n - first);
+            }
+        };
+
+        namespace
+        {
+            std::atomic<uint64_t> nextRecorderId{1};
+            std::atomic<FlightRecorderSink *> recorders[FlightRecorderSink::kMaxRecorders];
+
+            /// 每条记录在数据之外占用的字节数: 头部的长度与线程号、尾部的长度
+            const size_t kFrameBytes = 12;
+
+            /// 本线程使用的缓冲区;线程退出时释放其使用权(内容保留，直到被新线程接手)
+            struct LocalRings
+            {
+                std::vector<std::pair<uint64_t, std::shared_ptr<FlightRecorderSink::Ring>>> rings;
+
+                ~LocalRings()
+                {
+                    for (auto &r : rings)
+                        r.second->owned.store(false, std::memory_order_release);
+                }
+            };
+
+            thread_local LocalRings localRings;
+
+            long currentTid()
+            {
+#if defined(__linux__)
+                return (long)syscall(SYS_gettid);
+#else
+                static std::atomic<long> next{1};
+                thread_local long tid = next++;
+                return tid;
+#endif
+            }
+
+            /// 以下函数均为异步信号安全的
+            void writeAll(int fd, const char *data, size_t len)
+            {
+                while (len > 0)
+                {
+                    ssize_t n = ::write(fd, data, len);
+                    if (n < 0)
+                    {
+                        if (errno == EINTR)
+                            continue;
+                        return;
+                    }
+                    data += n;
+                    len -= (size_t)n;
+                }
+            }
+
+            void writeString(int fd, const char *s)
+            {
+                writeAll(fd, s, std::strlen(s));
+            }
+
+            void writeNumber(int fd, long v)
+            {
+                char buf[24];
+                char *end = buf + sizeof(buf);
+                char *p = end;
+                unsigned long u = v < 0 ? 0UL - (unsigned long)v : (unsigned long)v;
+                do
+                {
+                    *--p = (char)('0' + u % 10);
+                    u /= 10;
+                } while (u);
+                if (v < 0)
+                    *--p = '-';
+                writeAll(fd, p, end - p);
+            }
+
+            const int crashSignals[] = {SIGSEGV, SIGABRT, SIGBUS, SIGFPE, SIGILL};
+            const int kCrashSignalCount = sizeof(crashSignals) / sizeof(crashSignals[0]);
+            struct sigaction oldActions[kCrashSignalCount];
+            std::atomic<bool> crashing{false};
+
+            void crashHandler(int sig)
+            {
+                // 写出过程中再次崩溃时不再重复写出
+                if (!crashing.exchange(true))
+                {
+                    const char *name = "signal";
+                    if (sig == SIGSEGV)
+                        name = "SIGSEGV";
+                    else if (sig == SIGABRT)
+                        name = "SIGABRT";
+                    else if (sig == SIGBUS)
+                        name = "SIGBUS";
+                    else if (sig == SIGFPE)
+                        name = "SIGFPE";
+                    else if (sig == SIGILL)
+                        name = "SIGILL";
+                    FlightRecorderSink::dumpAll(name);
+                }
+
+                // 恢复原有的处理方式并重新发出信号
+                for (int i = 0; i < kCrashSignalCount; i++)
+                {
+                    if (crashSignals[i] == sig)
+                        sigaction(sig, &oldActions[i], nullptr);
+                }
+                raise(sig);
+            }
+        }
+
+        FlightRecorderSink::FlightRecorderSink(const std::string &dumpFile, size_t bytesPerThread, size_t maxRecords)
+            : _id(nextRecorderId++), _bytesPerThread(bytesPerThread < 256 ? 256 : bytesPerThread), _maxRecords(maxRecords)
+        {
+            std::strncpy(_dumpPath, dumpFile.c_str(), sizeof(_dumpPath) - 1);
+            _dumpPath[sizeof(_dumpPath) - 1] = '\0';
+            for (auto &s : _slots)
+                s.store(nullptr, std::memory_order_relaxed);
+
+            for (auto &r : recorders)
+            {
+                FlightRecorderSink *expected = nullptr;
+                if (r.compare_exchange_strong(expected, this))
+                    break;
+            }
+        }
+
+        FlightRecorderSink::~FlightRecorderSink()
+        {
+            for (auto &r : recorders)
+            {
+                FlightRecorderSink *expected = this;
+                r.compare_exchange_strong(expected, nullptr);
+            }
+
+            // 各线程的局部登记表在下次登记时删除这些缓冲区
+            std::lock_guard<std::mutex> lock(_ringsMutex);
+            for (auto &r : _rings)
+                r->closed.store(true, std::memory_order_release);
+        }
+
+        FlightRecorderSink::Ring *FlightRecorderSink::localRing()
+        {
+            for (auto &p : localRings.rings)
+            {
+                if (p.first == _id)
+                    return p.second.get();
+            }
+
+            // 顺便清理已销毁的记录仪留下的缓冲区
+            auto &local = localRings.rings;
+            local.erase(std::remove_if(local.begin(), local.end(), [](const std::pair<uint64_t, std::shared_ptr<Ring>> &p)
+                                       { return p.second->closed.load(std::memory_order_acquire); }),
+                        local.end());
+
+            std::shared_ptr<Ring> ring;
+            {
+                std::lock_guard<std::mutex> lock(_ringsMutex);
+                // 优先接手已退出线程的缓冲区
+                for (auto &r : _rings)
+                {
+                    bool expected = false;
+                    if (r->owned.compare_exchange_strong(expected, true, std::memory_order_acquire))
+                    {
+                        ring = r;
+                        break;
+                    }
+                }
+                if (!ring)
+                {
+                    if (_rings.size() >= kMaxThreads)
+                        return nullptr;
+                    ring = std::make_shared<Ring>();
+                    ring->capacity = _bytesPerThread;
+                    ring->bytes.reset(new char[_bytesPerThread]);
+                    _slots[_rings.size()].store(ring.get(), std::memory_order_release);
+                    _rings.push_back(ring);
+                }
+            }
+            ring->tid = (int32_t)currentTid();
+            local.emplace_back(_id, ring);
+            return ring.get();
+        }
+
+        void FlightRecorderSink::write(LogLevel, const char *data, size_t len)
+        {
+            Ring *r = localRing();
+            if (r == nullptr)
+                return;
+
+            // 超长的记录被截断，保证缓冲区中至少能放下一条
+            if (len + kFrameBytes > r->capacity)
+                len = r->capacity - kFrameBytes;
+            uint32_t n = (uint32_t)len;
+            uint64_t pos = r->committed.load(std::memory_order_relaxed);
+            uint64_t end = pos + len + kFrameBytes;
+
+            r->reserved.store(end, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            r->put(pos, &n, 4);
+            r->put(pos + 4, &r->tid, 4);
+            r->put(pos + 8, data, len);
+            r->put(pos + 8 + len, &n, 4);
+            r->committed.store(end, std::memory_order_release);
+        }
+
+        bool FlightRecorderSink::dump(const char *reason) const
+        {
+            int fd = ::open(_dumpPath, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+            if (fd < 0)
+                return false;
+            dumpTo(fd, reason);
+            ::close(fd);
+            return true;
+        }
+
+        void FlightRecorderSink::dumpTo(int fd, const char *reason) const
+        {
+            writeString(fd, "==== cfLog flight recorder dump: ");
+            writeString(fd, reason);
+            writeString(fd, " ====\n");
+
+            char chunk[512];
+            for (size_t i = 0; i < kMaxThreads; i++)
+            {
+                const Ring *r = _slots[i].load(std::memory_order_acquire);
+                if (r == nullptr)
+                    break;
+                uint64_t head = r->committed.load(std::memory_order_acquire);
+                if (head == 0)
+                    continue;
+                uint64_t cap = r->capacity;
+
+                // 从最新的记录向前回溯，找到仍完整保留在缓冲区中的最旧记录
+                uint64_t start = head;
+                size_t count = 0;
+                while (start >= kFrameBytes && (_maxRecords == 0 || count < _maxRecords))
+                {
+                    uint32_t n;
+                    r->get(start - 4, &n, 4);
+                    uint64_t total = (uint64_t)n + kFrameBytes;
+                    if (total > start || head - (start - total) > cap)
+                        break;
+                    start -= total;
+                    count++;
+                }
+
+                // 一个缓冲区可能先后属于多个线程: 线程号变化时输出新的标题
+                bool first = true;
+                int32_t lastTid = 0;
+                for (uint64_t pos = start; pos < head;)
+                {
+                    uint32_t n, tail;
+                    int32_t tid;
+                    r->get(pos, &n, 4);
+                    if (pos + n + kFrameBytes > head)
+                        break;
+                    r->get(pos + 4, &tid, 4);
+                    r->get(pos + 8 + n, &tail, 4);
+                    std::atomic_thread_fence(std::memory_order_acquire);
+                    // 读取期间被写入线程覆盖(或数据已不一致)的记录不再输出
+                    if (n != tail || r->reserved.load(std::memory_order_relaxed) - pos > cap)
+                        break;
+
+                    if (first || tid != lastTid)
+                    {
+                        writeString(fd, "---- thread ");
+                        writeNumber(fd, tid);
+                        writeString(fd, " ----\n");
+                        first = false;
+                        lastTid = tid;
+                    }
+
+                    // 经栈上的小缓冲区分块拷贝，每块拷贝后都检查是否已被覆盖
+                    bool overwritten = false;
+                    for (uint32_t off = 0; off < n && !overwritten;)
+                    {
+                        uint32_t m = n - off < sizeof(chunk) ? n - off : (uint32_t)sizeof(chunk);
+                        r->get(pos + 8 + off, chunk, m);
+                        std::atomic_thread_fence(std::memory_order_acquire);
+                        overwritten = r->reserved.load(std::memory_order_relaxed) - pos > cap;
+                        if (!overwritten)
+                            writeAll(fd, chunk, m);
+                        off += m;
+                    }
+                    writeAll(fd, "\n", 1);
+                    if (overwritten)
+                        break;
+                    pos += (uint64_t)n + kFrameBytes;
+                }
+            }
+        }
+
+        void FlightRecorderSink::dumpAll(const char *reason)
+        {
+            for (auto &r : recorders)
+            {
+                FlightRecorderSink *p = r.load(std::memory_order_acquire);
+                if (p)
+                    p->dump(reason);
+            }
+        }
+
+        void FlightRecorderSink::installCrashHandler()
+        {
+            // 只安装一次，否则保存的"原有处理方式"会变成本处理函数自身
+            static std::atomic<bool> installed{false};
+            if (installed.exchange(true))
+                return;
+
+            // 备用信号栈: 栈溢出时处理函数仍有栈可用
+            static const size_t kAltStackSize = 64 * 1024;
+            stack_t ss;
+            ss.ss_sp = std::malloc(kAltStackSize);
+            ss.ss_size = kAltStackSize;
+            ss.ss_flags = 0;
+            if (ss.ss_sp)
+                sigaltstack(&ss, nullptr);
+
+            struct sigaction sa;
+            std::memset(&sa, 0, sizeof(sa));
+            sa.sa_handler = crashHandler;
+            sigemptyset(&sa.sa_mask);
+            sa.sa_flags = SA_ONSTACK;
+            for (int i = 0; i < kCrashSignalCount; i++)
+                sigaction(crashSignals[i], &sa, &oldActions[i]);
+        }
+    };
+};
+
+#endif
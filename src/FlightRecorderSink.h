@@ -0,0 +1,117 @@
+/**
+ * @file FlightRecorderSink.h
+ * @author Genleung Lan (genleung@hotmail.com)
+ * @brief 内存中的"飞行记录仪": 保留各线程最近的log记录，崩溃时写出
+ * @version 0.1
+ * @date 2021-07-31
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#pragma once
+#include <atomic>
+#include <climits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "LogSink.h"
+
+#if !defined(_WIN32) && !defined(_WIN64)
+
+namespace cf
+{
+    namespace utils
+    {
+        /**
+         * @class cf::utils::FlightRecorderSink
+         * @brief 在内存中保留每个线程最近的log记录，在FATAL、显式调用或进程崩溃时写出到文件(仅POSIX系统).
+         * @details 每个线程有自己的环形字节缓冲区，只由该线程写入，写入时不加锁、不做I/O;
+         * 缓冲区写满后覆盖最旧的记录;线程退出后，其缓冲区(连同已有内容，仍标注为原来的线程)可被新线程接手。
+         * 写出时逐个线程、由旧到新输出记录，只使用open()/write()，因而可以在信号处理函数中调用。通常与MultiSink配合使用: 让文件只接收WARN以上的记录，
+         * 飞行记录仪接收所有等级的记录，以便在崩溃时得到完整的上下文。
+         * 本目标是perThread()的: 异步/暂存模式下记录也由产生它的线程在入队之前写入，而不是由后台写线程写入
+         */
+        class FlightRecorderSink : public LogSink
+        {
+        public:
+            /// 默认每个线程的缓冲区大小
+            static const size_t kDefaultBytesPerThread = 64 * 1024;
+            /// 最多记录的线程数，超出的线程不被记录
+            static const size_t kMaxThreads = 256;
+            /// 最多同时存在的飞行记录仪个数
+            static const size_t kMaxRecorders = 8;
+
+            /// 一个线程的环形缓冲区(内部使用)
+            struct Ring;
+
+            /**
+             * @brief 构造函数
+             *
+             * @param[in] dumpFile 写出记录的文件(以追加模式写入，每次写出前有一行分隔标题)
+             * @param[in] bytesPerThread 每个线程的缓冲区大小
+             * @param[in] maxRecords 每个线程最多写出的记录条数，0表示不限制(仅受缓冲区大小限制)
+             */
+            FlightRecorderSink(const std::string &dumpFile, size_t bytesPerThread = kDefaultBytesPerThread, size_t maxRecords = 0);
+            ~FlightRecorderSink();
+
+            FlightRecorderSink(const FlightRecorderSink &) = delete;
+            FlightRecorderSink &operator=(const FlightRecorderSink &) = delete;
+
+            void write(LogLevel level, const char *data, size_t len) override;
+            bool perThread() const override { return true; }
+
+            /**
+             * @brief 把各线程保留的记录追加到构造时指定的文件.
+             * @details 仅使用异步信号安全的函数，可在信号处理函数中调用;其它线程仍在写入时，被覆盖的记录会被跳过
+             *
+             * @param[in] reason 写出原因，写在分隔标题中
+             * @return true 成功; false 无法打开文件
+             */
+            bool dump(const char *reason = "api") const;
+
+            /**
+             * @brief 把各线程保留的记录写入已打开的文件描述符
+             *
+             * @param[in] fd 文件描述符
+             * @param[in] reason 写出原因，写在分隔标题中
+             */
+            void dumpTo(int fd, const char *reason) const;
+
+            /**
+             * @brief 让所有存活的飞行记录仪写出记录(异步信号安全).
+             * @details Log在记录FATAL后、调用fatal()前调用本函数
+             *
+             * @param[in] reason 写出原因
+             */
+            static void dumpAll(const char *reason);
+
+            /**
+             * @brief 为SIGSEGV、SIGABRT、SIGBUS、SIGFPE与SIGILL安装处理函数.
+             * @details 处理函数调用dumpAll()，随后恢复原有的处理方式并重新发出该信号(因而仍会产生core文件);
+             * 同时为调用线程设置备用信号栈，使栈溢出导致的SIGSEGV也能被处理
+             */
+            static void installCrashHandler();
+
+        private:
+            /**
+             * @brief 获取(必要时登记)调用线程的环形缓冲区
+             *
+             * @return Ring* 线程数超出kMaxThreads时返回空指针
+             */
+            Ring *localRing();
+
+        private:
+            const uint64_t _id;                          ///< 本记录仪的编号(全局唯一，不会重复使用)
+            const size_t _bytesPerThread;                ///< 每个线程的缓冲区大小
+            const size_t _maxRecords;                    ///< 每个线程最多写出的记录条数
+            char _dumpPath[PATH_MAX];                    ///< 写出记录的文件(信号处理函数中不能使用std::string)
+            std::atomic<Ring *> _slots[kMaxThreads];     ///< 供写出时无锁遍历的缓冲区表
+            std::vector<std::shared_ptr<Ring>> _rings;   ///< 所有缓冲区(持有其生命期)
+            std::mutex _ringsMutex;                      ///< 保护_rings，仅在线程登记时使用
+        };
+    };
+};
+
+#endif
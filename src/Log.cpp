@@ -2,7 +2,6 @@
 #include <string>
 #include <cstdarg>
 #include <chrono>
-#include <iomanip>
 #include <exception>
 
 namespace cf
@@ -11,11 +10,13 @@ namespace cf
     {
 
         std::shared_ptr<Log> Log::_ptr = nullptr;
-        std::mutex Log::_mutex;
         std::once_flag Log::_ponce;
+        thread_local uint64_t Log::_suppressedPending = 0;
+        thread_local LogSite *Log::_admittedSite = nullptr;
 
-        Log::Log() : _os(&std::cout)
+        Log::Log()
         {
+            LogSink::track(ConsoleSink::instance());
         }
 
         Log::Log(std::string logFile, bool append)
@@ -25,128 +26,393 @@ namespace cf
 
         Log::~Log()
         {
+            // 先停止后台写线程(会写完队列/暂存缓冲中剩余的记录)，再关闭文件
+            stopStatsTimer();
+            _async.reset();
+            _staging.reset();
+            _binary.reset();
+            stopFlushTimer();
             cleanupStream();
         }
 
         void Log::setLogFile(std::string logFile, bool append)
         {
-            if (logFile.empty())
-            {
-                // 加锁，防止此时有log信息写入
-                _mutex.lock();
+            std::shared_ptr<LogSink> sink;
+            if (!logFile.empty())
+                sink = FileSink::open(logFile, append);
+            if (!sink)
+                sink = ConsoleSink::instance();
 
-                cleanupStream();
-                _os = &std::cout;
+            setLogSink(sink);
+        }
 
-                _mutex.unlock();
+        void Log::setLogSink(std::shared_ptr<LogSink> sink)
+        {
+            // 切换输出目标前，确保已提交的记录写入旧目标
+            flushPending();
+
+            if (!sink)
+                sink = ConsoleSink::instance();
+            LogSink::track(sink);
+
+            // 发布新配置后，正在写入的线程写完旧目标即返回，新的记录写入新目标;
+            // 返回的旧配置已无人引用，刷新其输出目标后释放之(最后一个引用释放时关闭文件)
+            std::unique_ptr<LogConfig> old = _config.update([&](LogConfig &c)
+                                                            { c.sink = sink; });
+            _captureSink.store(sink->perThread() || std::dynamic_pointer_cast<MultiSink>(sink) != nullptr, std::memory_order_relaxed);
+            if (old->sink)
+                old->sink->flush();
+        }
 
+        void Log::addLogSink(std::shared_ptr<LogSink> sink, LogLevel minLevel, std::shared_ptr<LogFormatter> formatter)
+        {
+            if (!sink)
                 return;
+
+            std::shared_ptr<MultiSink> multi;
+            _config.update([&](LogConfig &c)
+                           {
+                               multi = std::dynamic_pointer_cast<MultiSink>(c.sink);
+                               if (!multi)
+                               {
+                                   // 原有的输出目标继续接收所有等级的记录
+                                   multi = std::make_shared<MultiSink>();
+                                   if (c.sink)
+                                       multi->addSink(c.sink);
+                                   LogSink::track(multi);
+                                   c.sink = multi;
+                               }
+                           });
+            _captureSink.store(true, std::memory_order_relaxed);
+            multi->addSink(sink, minLevel, formatter);
+        }
+
+        void Log::setBinaryLogFile(const std::string &file)
+        {
+            _binary.reset();
+            if (!file.empty())
+            {
+                _binary.reset(new BinaryLog(file));
+                if (!_binary->isOpen())
+                    _binary.reset();
             }
+        }
 
-            // 加锁，防止此时有log信息写入
-            _mutex.lock();
+        void Log::setLogLevel(LogLevel level)
+        {
+            _level.store(level, std::memory_order_relaxed);
+        }
 
-            cleanupStream();
-            if (append)
+        void Log::setRateLimit(unsigned perSecond, unsigned burst)
+        {
+            _rateBurst.store(burst, std::memory_order_relaxed);
+            _ratePerSecond.store(perSecond, std::memory_order_relaxed);
+        }
+
+        void Log::enableLogPosition(bool enabled, bool fullpathEnabled)
+        {
+            _config.update([&](LogConfig &c)
+                           {
+                               c.positionEnabled = enabled;
+                               c.positionFullpath = fullpathEnabled;
+                           });
+        }
+
+        void Log::enableLogTime(bool flag)
+        {
+            _config.update([&](LogConfig &c)
+                           { c.timeEnabled = flag; });
+        }
+
+        void Log::setTimeFormat(TimeFormat format, TimePrecision precision)
+        {
+            _config.update([&](LogConfig &c)
+                           {
+                               c.timeFormat = format;
+                               c.timePrecision = precision;
+                           });
+        }
+
+        void Log::enableAsync(bool enabled, size_t capacity, OverflowPolicy policy, LogLevel urgentLevel)
+        {
+            // 先停掉已有的写线程(会写完队列中剩余的记录)
+            _async.reset();
+            if (enabled)
             {
-                _ofs.open(logFile, std::ios::out | std::ios::app);
+                _staging.reset();
+                _async.reset(new AsyncWriter(this, capacity, policy, urgentLevel));
             }
-            else
+        }
+
+        void Log::enableStaging(bool enabled, size_t bufferSize, unsigned maxStalenessMs, size_t maxPendingBuffers, OverflowPolicy policy)
+        {
+            // 先停掉已有的合并线程(会写完暂存的记录)
+            _staging.reset();
+            if (enabled)
             {
-                _ofs.open(logFile, std::ios::out);
+                _async.reset();
+                _staging.reset(new StagingWriter(this, bufferSize, maxStalenessMs, maxPendingBuffers, policy));
             }
+        }
+
+        void Log::flushPending()
+        {
+            if (_async)
+                _async->flush();
+            if (_staging)
+                _staging->flush();
+            if (_binary)
+                _binary->flush();
+        }
 
-            if (_ofs.is_open())
+        void Log::setFlushPolicy(const FlushPolicy &policy)
+        {
+            stopFlushTimer();
+            _config.update([&](LogConfig &c)
+                           { c.flushPolicy = policy; });
+            if (policy.intervalMs > 0)
             {
-                _os = &_ofs;
+                _timerStop = false;
+                _timerThread = std::thread(&Log::flushTimer, this);
             }
-            else
+        }
+
+        void Log::stopFlushTimer()
+        {
+            if (!_timerThread.joinable())
+                return;
             {
-                _os = &std::cout;
+                std::lock_guard<std::mutex> lock(_timerMutex);
+                _timerStop = true;
+                _timerCond.notify_one();
             }
+            _timerThread.join();
+        }
 
-            _mutex.unlock();
+        void Log::flushTimer()
+        {
+            unsigned intervalMs = LogSnapshot<LogConfig>::Reader(_config)->flushPolicy.intervalMs;
+            std::unique_lock<std::mutex> lock(_timerMutex);
+            while (!_timerCond.wait_for(lock, std::chrono::milliseconds(intervalMs), [&]()
+                                        { return _timerStop; }))
+            {
+                if (_unflushedRecords.load(std::memory_order_relaxed) > 0)
+                {
+                    LogSnapshot<LogConfig>::Reader config(_config);
+                    _unflushedRecords.store(0, std::memory_order_relaxed);
+                    _unflushedBytes.store(0, std::memory_order_relaxed);
+                    config->sink->flush();
+                    _stats.flushed();
+                }
+            }
         }
 
-        void Log::setLogLevel(LogLevel level)
+        void Log::flush()
         {
-            _level = level;
+            reportSuppressed();
+            flushPending();
+
+            LogSnapshot<LogConfig>::Reader config(_config);
+            _unflushedRecords.store(0, std::memory_order_relaxed);
+            _unflushedBytes.store(0, std::memory_order_relaxed);
+            if (config->sink)
+            {
+                config->sink->flush();
+                _stats.flushed();
+            }
         }
 
-        void Log::enableLogPosition(bool enabled, bool fullpathEnabled)
+        uint64_t Log::droppedCount() const
         {
-            _positionEnabled = enabled;
-            _positionFullpathEnabled = fullpathEnabled;
+            if (_async)
+                return _async->droppedCount();
+            return _staging ? _staging->droppedCount() : 0;
         }
 
-        void Log::enableLogTime(bool flag)
+        LogStats Log::stats()
         {
-            _timeEnabled = flag;
+            LogStats s;
+            _stats.snapshot(s);
+            LogSnapshot<LogConfig>::Reader config(_config);
+            if (config->sink)
+            {
+                s.lockWaitNs = config->sink->lockWaitNanos();
+                s.sinkDropped = config->sink->droppedCount();
+            }
+            return s;
         }
 
-        LogStream Log::createLogStream(LogLevel curLevel, std::string tagString, std::string srcFile, int srcLine)
+        void Log::enableLatencyStats(bool enabled)
         {
-            const static char *levelStr[] = {"[I]", "[N]", "[W]", "[E]", "[F]"};
-            std::stringstream ss;
-            std::time_t now_c = std::time(0);
+            _latencyStats.store(enabled, std::memory_order_relaxed);
+        }
 
-            ss << levelStr[(int)curLevel];
-            if(tagString.length()){
-                ss << "[" << tagString << "]";
+        void Log::enableFilteredStats(bool enabled)
+        {
+            _filteredStats.store(enabled, std::memory_order_relaxed);
+        }
+
+        void Log::setStatsInterval(unsigned seconds, LogLevel level)
+        {
+            stopStatsTimer();
+            _statsInterval = seconds;
+            _statsLevel = level;
+            if (seconds > 0)
+            {
+                _statsStop = false;
+                _statsThread = std::thread(&Log::statsTimer, this);
             }
+        }
 
-            if (_timeEnabled)
+        void Log::stopStatsTimer()
+        {
+            if (!_statsThread.joinable())
+                return;
             {
-                std::tm t;
-#if defined(_WIN32) || defined(_WIN64)
-                localtime_s(&t, &now_c);
-#else
-                localtime_r(&now_c, &t);
-#endif
-                ss << "[" << t.tm_year + 1900 << "-"
-                   << std::setw(2) << std::setfill('0') << t.tm_mon + 1 << "-"
-                   << std::setw(2) << std::setfill('0') << t.tm_mday + 1 << " "
-                   << std::setw(2) << std::setfill('0') << t.tm_hour << ":"
-                   << std::setw(2) << std::setfill('0') << t.tm_min << ":"
-                   << std::setw(2) << std::setfill('0') << t.tm_sec << "]";
+                std::lock_guard<std::mutex> lock(_statsMutex);
+                _statsStop = true;
+                _statsCond.notify_one();
             }
+            _statsThread.join();
+        }
 
-            if (_positionEnabled && srcFile.length())
+        void Log::statsTimer()
+        {
+            std::unique_lock<std::mutex> lock(_statsMutex);
+            while (!_statsCond.wait_for(lock, std::chrono::seconds(_statsInterval), [&]()
+                                        { return _statsStop; }))
             {
-                if (_positionFullpathEnabled)
+                reportSuppressed();
+                LogStats s = stats();
+                LogStream ls = createLogStream(_statsLevel, "cflog");
+                ls << "logger stats";
+                ls.kv("emitted", LogStats::total(s.emitted));
+                if (_filteredStats.load(std::memory_order_relaxed))
+                    ls.kv("filtered", LogStats::total(s.filtered));
+                ls.kv("dropped", LogStats::total(s.dropped))
+                    .kv("bytes", s.bytesWritten)
+                    .kv("flushes", s.flushes)
+                    .kv("lock_wait_us", s.lockWaitNs / 1000);
+                if (s.sinkDropped)
+                    ls.kv("sink_dropped", s.sinkDropped);
+                if (s.enqueueLatency.count)
                 {
-                    // 获得srcFile的完整路径，以及log发生的所在行
-                    ss << "[" << srcFile;
-                    if (srcLine >= 0)
-                        ss << ":" << srcLine;
-                    ss << "] ";
+                    ls.kv("enqueue_p99_ns", s.enqueueLatency.percentile(0.99))
+                        .kv("write_p99_ns", s.writeLatency.percentile(0.99))
+                        .kv("write_max_ns", s.writeLatency.maxNs);
                 }
+            }
+        }
+
+        void Log::listLimitedSite(LogSite &site)
+        {
+            LogSite *head = _limitedSites.load(std::memory_order_relaxed);
+            do
+            {
+                site.nextLimited = head;
+            } while (!_limitedSites.compare_exchange_weak(head, &site, std::memory_order_release, std::memory_order_relaxed));
+        }
+
+        void Log::reportSuppressed()
+        {
+            for (LogSite *site = _limitedSites.load(std::memory_order_acquire); site; site = site->nextLimited)
+            {
+                // FATAL记录会终结进程，不能用来报告;等级被过滤时暂不取走，留待之后报告
+                if (site->level == LogLevel::FATAL || !isLevelEnabled(site->level))
+                    continue;
+                uint64_t suppressed = site->limiter.takeSuppressed();
+                if (suppressed == 0)
+                    continue;
+                LogStream ls = createLogStream(*site);
+                ls << "rate limited";
+                ls.kv("suppressed", suppressed);
+            }
+        }
+
+        LogStream Log::createLogStream(LogLevel curLevel, const char *tagString, const char *srcFile, int srcLine)
+        {
+            // 运行时构造的调用点信息: 与宏在编译期生成的相同，只是长度与文件名在这里计算;
+            // 只引用调用者的字符串，不做拷贝
+            LogSite site(curLevel, tagString, srcFile, srcLine);
+            return createLogStream(site);
+        }
+
+        LogStream Log::createLogStream(const LogSite &site)
+        {
+            // 被过滤掉的等级返回一个不做任何格式化、也不会输出的LogStream
+            if (!checkLevel(site.level))
+                return LogStream(nullptr, site.level);
+
+            // 前缀直接写入LogStream的缓冲区，不再经过临时的stringstream
+            LogStream ls(this, site.level);
+
+            ls.write(site.levelString, 3);
+            if (site.tagLength)
+            {
+                ls._layout.tagOffset = (uint32_t)ls.size() + 1;
+                ls._layout.tagLength = (uint32_t)site.tagLength;
+                ls.put('[');
+                ls.write(site.tag, site.tagLength);
+                ls.put(']');
+            }
+
+            LogSnapshot<LogConfig>::Reader config(_config);
+            if (config->timeEnabled)
+            {
+                char tbuf[LogTime::kMaxLength + 2];
+                tbuf[0] = '[';
+                size_t n = LogTime::format(tbuf + 1, config->timeFormat, config->timePrecision) + 1;
+                ls._layout.timeOffset = (uint32_t)ls.size() + 1;
+                ls._layout.timeLength = (uint32_t)n - 1;
+                tbuf[n++] = ']';
+                ls.write(tbuf, n);
+            }
+
+            if (config->positionEnabled && site.pathLength)
+            {
+                // 完整路径或仅文件名(已在编译期去掉目录部分)，以及log发生的所在行
+                ls._layout.posOffset = (uint32_t)ls.size() + 1;
+                ls.put('[');
+                if (config->positionFullpath)
+                    ls.write(site.path, site.pathLength);
                 else
+                    ls.write(site.file, site.fileLength);
+                if (site.line >= 0)
                 {
-                    // 仅获得srcFile路径中的最后文件名，以及log发生的所在行
-                    ss << "[" << srcFile.substr(srcFile.find_last_of("/\\") + 1);
-                    if (srcLine >= 0)
-                        ss << ":" << srcLine;
-                    ss << "] ";
+                    ls.put(':');
+                    LogFormat::writeValue(ls.rdbuf(), ls, site.line);
                 }
+                ls._layout.posLength = (uint32_t)ls.size() - ls._layout.posOffset;
+                ls.write("] ", 2);
             }
             else
             {
-                ss << " ";
+                ls.put(' ');
             }
 
-            return LogStream(this, curLevel, ss.str());
+            ls._layout.messageOffset = (uint32_t)ls.size();
+
+            // 本线程的上下文字段已预先编码，整块拷贝即可
+            const std::string &context = LogContext::current();
+            if (!context.empty())
+                ls._fields.sputn(context.data(), (std::streamsize)context.size());
+
+            if (_suppressedPending)
+            {
+                // 该调用点此前被限速丢弃的记录数
+                ls.kv("suppressed", _suppressedPending);
+                _suppressedPending = 0;
+            }
+            return ls;
         }
 
         void Log::cleanupStream()
         {
-            if (_os)
-                _os->flush();
-            if (_ofs.is_open())
-            {
-                _ofs.flush();
-                _ofs.close();
-            }
+            // 输出目标可能被其它Log对象共享，这里只刷新并释放本对象的引用，文件在最后一个引用释放时关闭
+            std::unique_ptr<LogConfig> old = _config.update([](LogConfig &c)
+                                                             { c.sink.reset(); });
+            if (old->sink)
+                old->sink->flush();
         }
 
         /// 把LogStream中的log信息写入到目标文件.
@@ -156,65 +422,150 @@ namespace cf
                 return;
 
             // log输出受到_level限制。
-            if (ls->_curLevel < _level)
+            if (!checkLevel(ls->_curLevel))
                 return;
-
-            // 写入log信息时上锁，基于两点考虑：
-            // 1、防止线程间写入彼此干扰
-            // 2、防止写入时setLogFile()被调用
-            _mutex.lock();
-            (*_os) << ls->str() << std::endl;
-            _mutex.unlock();
+            _stats.emitted(ls->_curLevel);
+            bool timed = _latencyStats.load(std::memory_order_relaxed);
+            std::chrono::steady_clock::time_point start;
+            if (timed)
+                start = std::chrono::steady_clock::now();
+
+            LogRecordView rec;
+            rec.level = ls->_curLevel;
+            rec.text = ls->data();
+            rec.textLength = ls->size();
+            rec.fields = ls->fieldsData();
+            rec.fieldsLength = ls->fieldsSize();
+            rec.layout = ls->_layout;
+
+            if (_async && rec.level == LogLevel::FATAL)
+            {
+                // 进程即将终结: 等写线程写完紧急通道中较早的记录(不等普通通道的积压)，再直接写入fatal记录
+                _async->waitUrgent();
+                write(rec, true);
+            }
+            else if (_async)
+            {
+                // 异步模式: 仅入队，由后台线程写入(按线程保存记录的目标在入队前由本线程写入)
+                capture(rec);
+                if (!_async->push(rec))
+                    _stats.dropped(rec.level);
+            }
+            else if (_staging)
+            {
+                // 暂存模式: 追加到本线程的暂存缓冲区，由后台线程整块合并写入
+                capture(rec);
+                if (!_staging->push(rec))
+                    _stats.dropped(rec.level);
+            }
+            else
+            {
+                write(rec, true);
+            }
+            if (timed)
+                _stats.enqueueLatency((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
 
             // 如果是fatal log，则终结进程
             if (ls->_curLevel == LogLevel::FATAL)
             {
+                // 确保队列中其余的记录在终结进程前也已被写出
+                flushPending();
                 std::cerr<<"[F] Fatal error occured!"<<std::endl;
+                // 进程即将终结: 刷新所有正在使用的输出目标
+                LogSink::flushAll();
+#if !defined(_WIN32) && !defined(_WIN64)
+                // 写出飞行记录仪中保留的上下文
+                FlightRecorderSink::dumpAll("fatal");
+#endif
                 fatal();
             }
         }
 
-        void Log::fatal()
+        void Log::capture(const LogRecordView &rec)
         {
-            throw "Fatal error occured.";
+            // 普通输出目标不需要在本线程上写入，不必进入读区
+            if (!_captureSink.load(std::memory_order_relaxed))
+                return;
+            LogSnapshot<LogConfig>::Reader config(_config);
+            config->sink->capture(rec);
         }
 
-        std::string Log::formatString(char *format, ...)
+        void Log::write(const LogRecordView &rec, bool capture)
         {
-            char buf[512] = {0};
+            // 读区仅保证写入期间输出目标不被释放，各线程之间、与修改配置的线程之间均不互斥;
+            // 同一输出目标上的记录由目标自身的互斥量保证不相互交错
+            bool timed = _latencyStats.load(std::memory_order_relaxed);
+            std::chrono::steady_clock::time_point start;
+            if (timed)
+                start = std::chrono::steady_clock::now();
+
+            LogSnapshot<LogConfig>::Reader config(_config);
+            if (capture)
+                config->sink->capture(rec);
+            if (!config->sink->perThread())
+                config->sink->writeRecord(rec);
+            _stats.written(rec.textLength + rec.fieldsLength);
+            if (needFlush(config->flushPolicy, rec.level, rec.textLength + rec.fieldsLength))
+            {
+                config->sink->flush();
+                _stats.flushed();
+            }
 
-            va_list st;
-            va_start(st, format);
-            int nw = vsnprintf(buf, sizeof(buf), format, st);
-            va_end(st);
+            if (timed)
+                _stats.writeLatency((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+        }
 
-            std::string str(buf);
-            if (nw >= sizeof(buf))
+        bool Log::needFlush(const FlushPolicy &p, LogLevel level, size_t len)
+        {
+            if (level >= p.flushLevel || level == LogLevel::FATAL || p.everyRecords == 1)
             {
-                // buf太小，导致log信息被截断了
-                // TODO: 增大buf的固定大小，或者其他机制。
-                str += " ... ";
+                _unflushedRecords.store(0, std::memory_order_relaxed);
+                _unflushedBytes.store(0, std::memory_order_relaxed);
+                return true;
             }
 
-            return str;
+            size_t records = _unflushedRecords.fetch_add(1, std::memory_order_relaxed) + 1;
+            size_t bytes = _unflushedBytes.fetch_add(len + 1, std::memory_order_relaxed) + len + 1;
+            if ((p.everyRecords > 0 && records >= p.everyRecords) || (p.everyBytes > 0 && bytes >= p.everyBytes))
+            {
+                _unflushedRecords.store(0, std::memory_order_relaxed);
+                _unflushedBytes.store(0, std::memory_order_relaxed);
+                return true;
+            }
+            return false;
+        }
+
+        void Log::fatal()
+        {
+            throw "Fatal error occured.";
         }
 
         std::string Log::formatString(const char *format, ...)
         {
-            char buf[512] = {0};
+            char buf[512];
 
-            va_list st;
+            va_list st, st2;
             va_start(st, format);
+            va_copy(st2, st);
             int nw = vsnprintf(buf, sizeof(buf), format, st);
             va_end(st);
 
-            std::string str(buf);
-            if (nw >= sizeof(buf))
+            std::string str;
+            if (nw < 0)
             {
-                // buf太小，导致log信息被截断了
-                // TODO: 增大buf的固定大小，或者其他机制。
-                str += " ... ";
+                // 格式字符串有误
             }
+            else if ((size_t)nw < sizeof(buf))
+            {
+                str.assign(buf, nw);
+            }
+            else
+            {
+                // buf太小，按实际长度重新格式化，不再截断
+                str.resize(nw);
+                vsnprintf(&str[0], nw + 1, format, st2);
+            }
+            va_end(st2);
 
             return str;
         }
@@ -229,6 +580,26 @@ namespace cf
             Log::instance()->setLogFile(file, append);
         }
 
+        void setLogSink(std::shared_ptr<LogSink> sink)
+        {
+            Log::instance()->setLogSink(sink);
+        }
+
+        void addLogSink(std::shared_ptr<LogSink> sink, LogLevel minLevel, std::shared_ptr<LogFormatter> formatter)
+        {
+            Log::instance()->addLogSink(sink, minLevel, formatter);
+        }
+
+        void setBinaryLogFile(const std::string &file)
+        {
+            Log::instance()->setBinaryLogFile(file);
+        }
+
+        void setRateLimit(unsigned perSecond, unsigned burst)
+        {
+            Log::instance()->setRateLimit(perSecond, burst);
+        }
+
         void enableLogPosition(bool filenameLogged, bool fullpathLogged)
         {
             Log::instance()->enableLogPosition(filenameLogged, fullpathLogged);
@@ -239,5 +610,50 @@ namespace cf
             Log::instance()->enableLogTime(timeLogged);
         }
 
+        void setTimeFormat(TimeFormat format, TimePrecision precision)
+        {
+            Log::instance()->setTimeFormat(format, precision);
+        }
+
+        void enableAsync(bool enabled, size_t capacity, OverflowPolicy policy, LogLevel urgentLevel)
+        {
+            Log::instance()->enableAsync(enabled, capacity, policy, urgentLevel);
+        }
+
+        void enableStaging(bool enabled, size_t bufferSize, unsigned maxStalenessMs, size_t maxPendingBuffers, OverflowPolicy policy)
+        {
+            Log::instance()->enableStaging(enabled, bufferSize, maxStalenessMs, maxPendingBuffers, policy);
+        }
+
+        void setFlushPolicy(const FlushPolicy &policy)
+        {
+            Log::instance()->setFlushPolicy(policy);
+        }
+
+        void flushLog()
+        {
+            Log::instance()->flush();
+        }
+
+        LogStats logStats()
+        {
+            return Log::instance()->stats();
+        }
+
+        void enableLatencyStats(bool enabled)
+        {
+            Log::instance()->enableLatencyStats(enabled);
+        }
+
+        void enableFilteredStats(bool enabled)
+        {
+            Log::instance()->enableFilteredStats(enabled);
+        }
+
+        void setStatsInterval(unsigned seconds, LogLevel level)
+        {
+            Log::instance()->setStatsInterval(seconds, level);
+        }
+
     };
 };
@@ -10,11 +10,31 @@
  */
 
 #pragma once
+#include <atomic>
 #include <iostream>
 #include <memory>
 #include <mutex>
-#include <fstream>
+#include <condition_variable>
+#include <thread>
 #include "LogStream.h"
+#include "LogSink.h"
+#include "RotatingFileSink.h"
+#include "FdFileSink.h"
+#include "MmapFileSink.h"
+#include "ShmRingSink.h"
+#include "FlightRecorderSink.h"
+#include "MultiSink.h"
+#include "LogEncoder.h"
+#include "AsyncWriter.h"
+#include "StagingWriter.h"
+#include "LogTime.h"
+#include "LogFormat.h"
+#include "LogSite.h"
+#include "BinaryLog.h"
+#include "LogStats.h"
+#include "LogSnapshot.h"
+#include "LogContext.h"
+#include "LogTrace.h"
 
 namespace cf
 {
@@ -33,6 +53,16 @@ namespace cf
             #define LOGW(...) __android_log_print(ANDROID_LOG_WARN, LOG_TAG, __VA_ARGS__)
             #define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
             #define LOGF(...) __android_log_print(ANDROID_LOG_FATAL, LOG_TAG, __VA_ARGS__)
+            #define LOG_FMT(fmt, ...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, "%s", CFLOG_FORMAT(fmt, ##__VA_ARGS__).str().c_str())
+            #define LOGI_FMT(fmt, ...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, "%s", CFLOG_FORMAT(fmt, ##__VA_ARGS__).str().c_str())
+            #define LOGW_FMT(fmt, ...) __android_log_print(ANDROID_LOG_WARN, LOG_TAG, "%s", CFLOG_FORMAT(fmt, ##__VA_ARGS__).str().c_str())
+            #define LOGE_FMT(fmt, ...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, "%s", CFLOG_FORMAT(fmt, ##__VA_ARGS__).str().c_str())
+            #define LOGF_FMT(fmt, ...) __android_log_print(ANDROID_LOG_FATAL, LOG_TAG, "%s", CFLOG_FORMAT(fmt, ##__VA_ARGS__).str().c_str())
+            #define LOG_BIN(fmt, ...) LOG_FMT(fmt, ##__VA_ARGS__)
+            #define LOGI_BIN(fmt, ...) LOGI_FMT(fmt, ##__VA_ARGS__)
+            #define LOGW_BIN(fmt, ...) LOGW_FMT(fmt, ##__VA_ARGS__)
+            #define LOGE_BIN(fmt, ...) LOGE_FMT(fmt, ##__VA_ARGS__)
+            #define LOGF_BIN(fmt, ...) LOGF_FMT(fmt, ##__VA_ARGS__)
             #ifdef TRACE_ENABLED
                 #define TRACE(msg) LOGI(" %s(%d)::%s: %s", __FILE__, __LINE__, __FUNCTION__, msg)
                 #define TRACEI(msg) LOGI(" %s(%d)::%s: %s", __FILE__, __LINE__, __FUNCTION__, msg)
@@ -43,6 +73,11 @@ namespace cf
                 #define TRACEWF(format, ...) LOGW(" %s(%d)::%s: " # format, __FILE__, __LINE__, __FUNCTION__, __VA_ARGS__)
                 #define TRACEEF(format, ...) LOGE(" %s(%d)::%s: " # format, __FILE__, __LINE__, __FUNCTION__, __VA_ARGS__)
                 #define TRACEFF(format, ...) LOGF(" %s(%d)::%s: " # format, __FILE__, __LINE__, __FUNCTION__, __VA_ARGS__)
+                #define TRACE_FMT(fmt, ...) LOGI(" %s(%d)::%s: %s", __FILE__, __LINE__, __FUNCTION__, CFLOG_FORMAT(fmt, ##__VA_ARGS__).str().c_str())
+                #define TRACEI_FMT(fmt, ...) LOGI(" %s(%d)::%s: %s", __FILE__, __LINE__, __FUNCTION__, CFLOG_FORMAT(fmt, ##__VA_ARGS__).str().c_str())
+                #define TRACEW_FMT(fmt, ...) LOGW(" %s(%d)::%s: %s", __FILE__, __LINE__, __FUNCTION__, CFLOG_FORMAT(fmt, ##__VA_ARGS__).str().c_str())
+                #define TRACEE_FMT(fmt, ...) LOGE(" %s(%d)::%s: %s", __FILE__, __LINE__, __FUNCTION__, CFLOG_FORMAT(fmt, ##__VA_ARGS__).str().c_str())
+                #define TRACEF_FMT(fmt, ...) LOGF(" %s(%d)::%s: %s", __FILE__, __LINE__, __FUNCTION__, CFLOG_FORMAT(fmt, ##__VA_ARGS__).str().c_str())
             #else
                 #define TRACE(msg) (static_cast<void>(0))
                 #define TRACEI(msg) (static_cast<void>(0))
@@ -53,25 +88,62 @@ namespace cf
                 #define TRACEWF(format, ...) (static_cast<void>(0))
                 #define TRACEEF(format, ...) (static_cast<void>(0))
                 #define TRACEFF(format, ...) (static_cast<void>(0))
+                #define TRACE_FMT(fmt, ...) (static_cast<void>(0))
+                #define TRACEI_FMT(fmt, ...) (static_cast<void>(0))
+                #define TRACEW_FMT(fmt, ...) (static_cast<void>(0))
+                #define TRACEE_FMT(fmt, ...) (static_cast<void>(0))
+                #define TRACEF_FMT(fmt, ...) (static_cast<void>(0))
             #endif
         #else   // using standard C++ (Linux/Windows/MacOS)
-            #define LOGL(level) Log::instance()->createLogStream(LogLevel::level, LOG_TAG)
-            #define LOG(...) LOGL(INFO) << Log::formatString(__VA_ARGS__)
-            #define LOGI(...) LOGL(INFO) << Log::formatString(__VA_ARGS__)
-            #define LOGW(...) LOGL(WARN) << Log::formatString(__VA_ARGS__)
-            #define LOGE(...) LOGL(ERROR) << Log::formatString(__VA_ARGS__)
-            #define LOGF(...) LOGL(FATAL) << Log::formatString(__VA_ARGS__)
+            // 低于编译期最低等级CFLOG_MIN_LEVEL的语句条件恒为真，整条语句在编译时被去除;
+            // 再以一次原子读判断等级是否被允许，被过滤掉的log语句不会构造LogStream，也不会对参数求值;
+            // 最后以调用点的静态信息(编译期常量初始化)判断是否被限速，放行后只把该调用点的指针交给createLogStream()
+            #define CFLOG_SITE(level, srcFile, srcLine, perSecond, burst) ([]() -> cf::utils::LogSite & { static cf::utils::LogSite _cflogSite(cf::utils::LogLevel::level, LOG_TAG, srcFile, srcLine, perSecond, burst); return _cflogSite; }())
+            #define CFLOG_STREAM(level, srcFile, srcLine, perSecond, burst) ((int)cf::utils::LogLevel::level < CFLOG_MIN_LEVEL || !Log::instance()->checkLevel(LogLevel::level) || !Log::instance()->admit(CFLOG_SITE(level, srcFile, srcLine, perSecond, burst))) ? (void)0 : LogVoidify() & Log::instance()->createLogStream(Log::admittedSite())
+            #define LOGL_LIMIT(level, perSecond, burst) CFLOG_STREAM(level, "", -1, perSecond, burst)
+            #define LOGL(level) LOGL_LIMIT(level, 0, 0)
+            #define LOG(...) LOGL(INFO).printf(__VA_ARGS__)
+            #define LOGI(...) LOGL(INFO).printf(__VA_ARGS__)
+            #define LOGW(...) LOGL(WARN).printf(__VA_ARGS__)
+            #define LOGE(...) LOGL(ERROR).printf(__VA_ARGS__)
+            #define LOGF(...) LOGL(FATAL).printf(__VA_ARGS__)
+            // "{}"风格的类型安全格式化: 占位符与参数个数在编译期检查，参数直接写入LogStream的缓冲区
+            #define LOG_FMT(fmt, ...) LOGL(INFO) << CFLOG_FORMAT(fmt, ##__VA_ARGS__)
+            #define LOGI_FMT(fmt, ...) LOGL(INFO) << CFLOG_FORMAT(fmt, ##__VA_ARGS__)
+            #define LOGW_FMT(fmt, ...) LOGL(WARN) << CFLOG_FORMAT(fmt, ##__VA_ARGS__)
+            #define LOGE_FMT(fmt, ...) LOGL(ERROR) << CFLOG_FORMAT(fmt, ##__VA_ARGS__)
+            #define LOGF_FMT(fmt, ...) LOGL(FATAL) << CFLOG_FORMAT(fmt, ##__VA_ARGS__)
+            // 二进制(延迟格式化)log: 调用点信息登记一次，每条记录只写入调用点编号、时间戳与参数的原始字节;
+            // 未设置二进制log文件时退化为LOG*_FMT的文本输出. 这些宏是完整的语句，不支持后续的"<<"
+            #define LOGL_BIN(level, fmt, ...) \
+                do { \
+                    if ((int)LogLevel::level >= CFLOG_MIN_LEVEL && Log::instance()->checkLevel(LogLevel::level)) { \
+                        static cf::utils::BinaryLogSite _cflogSite(fmt, __FILE__, __LINE__, LogLevel::level, LOG_TAG); \
+                        Log::instance()->logBinary(_cflogSite, CFLOG_FORMAT(fmt, ##__VA_ARGS__)); \
+                    } \
+                } while (0)
+            #define LOG_BIN(fmt, ...) LOGL_BIN(INFO, fmt, ##__VA_ARGS__)
+            #define LOGI_BIN(fmt, ...) LOGL_BIN(INFO, fmt, ##__VA_ARGS__)
+            #define LOGW_BIN(fmt, ...) LOGL_BIN(WARN, fmt, ##__VA_ARGS__)
+            #define LOGE_BIN(fmt, ...) LOGL_BIN(ERROR, fmt, ##__VA_ARGS__)
+            #define LOGF_BIN(fmt, ...) LOGL_BIN(FATAL, fmt, ##__VA_ARGS__)
             #ifdef TRACE_ENABLED
-                #define TRACEL(level) Log::instance()->createLogStream(LogLevel::level, LOG_TAG, __FILE__, __LINE__)
-                #define TRACE(...) TRACEL(INFO) << Log::formatString(__VA_ARGS__)
-                #define TRACEI(...) TRACEL(INFO) << Log::formatString(__VA_ARGS__)
-                #define TRACEW(...) TRACEL(WARN) << Log::formatString(__VA_ARGS__)
-                #define TRACEE(...) TRACEL(ERROR) << Log::formatString(__VA_ARGS__)
-                #define TRACEF(...) TRACEL(FATAL) << Log::formatString(__VA_ARGS__)
+                #define TRACEL_LIMIT(level, perSecond, burst) CFLOG_STREAM(level, __FILE__, __LINE__, perSecond, burst)
+                #define TRACEL(level) TRACEL_LIMIT(level, 0, 0)
+                #define TRACE(...) TRACEL(INFO).printf(__VA_ARGS__)
+                #define TRACEI(...) TRACEL(INFO).printf(__VA_ARGS__)
+                #define TRACEW(...) TRACEL(WARN).printf(__VA_ARGS__)
+                #define TRACEE(...) TRACEL(ERROR).printf(__VA_ARGS__)
+                #define TRACEF(...) TRACEL(FATAL).printf(__VA_ARGS__)
                 #define TRACEIF(...) TRACEI(__VA_ARGS__)
                 #define TRACEWF(...) TRACEW(__VA_ARGS__)
                 #define TRACEEF(...) TRACEE(__VA_ARGS__)
                 #define TRACEFF(...) TRACEF(__VA_ARGS__)
+                #define TRACE_FMT(fmt, ...) TRACEL(INFO) << CFLOG_FORMAT(fmt, ##__VA_ARGS__)
+                #define TRACEI_FMT(fmt, ...) TRACEL(INFO) << CFLOG_FORMAT(fmt, ##__VA_ARGS__)
+                #define TRACEW_FMT(fmt, ...) TRACEL(WARN) << CFLOG_FORMAT(fmt, ##__VA_ARGS__)
+                #define TRACEE_FMT(fmt, ...) TRACEL(ERROR) << CFLOG_FORMAT(fmt, ##__VA_ARGS__)
+                #define TRACEF_FMT(fmt, ...) TRACEL(FATAL) << CFLOG_FORMAT(fmt, ##__VA_ARGS__)
             #else
                 #define TRACE(msg) (static_cast<void>(0))
                 #define TRACEI(msg) (static_cast<void>(0))
@@ -82,6 +154,11 @@ namespace cf
                 #define TRACEWF(format, ...) (static_cast<void>(0))
                 #define TRACEEF(format, ...) (static_cast<void>(0))
                 #define TRACEFF(format, ...) (static_cast<void>(0))
+                #define TRACE_FMT(fmt, ...) (static_cast<void>(0))
+                #define TRACEI_FMT(fmt, ...) (static_cast<void>(0))
+                #define TRACEW_FMT(fmt, ...) (static_cast<void>(0))
+                #define TRACEE_FMT(fmt, ...) (static_cast<void>(0))
+                #define TRACEF_FMT(fmt, ...) (static_cast<void>(0))
             #endif 
         #endif  
 
@@ -98,6 +175,34 @@ namespace cf
             FATAL     ///< 致命错误(将导致进程退出)
         };
 
+        /**
+         * @brief 输出目标的刷新策略.
+         * @details 各条件之间为"或"的关系;FATAL记录总是立即刷新
+         */
+        struct FlushPolicy
+        {
+            size_t everyRecords = 1;               ///< 每累计N条记录刷新一次，0表示不按条数刷新
+            size_t everyBytes = 0;                 ///< 每累计N字节刷新一次，0表示不按字节数刷新
+            unsigned intervalMs = 0;               ///< 由后台定时器每隔N毫秒刷新一次，0表示不定时刷新
+            LogLevel flushLevel = LogLevel::ERROR; ///< 达到该等级的记录写入后立即刷新
+        };
+
+        /**
+         * @brief Log对象的配置快照.
+         * @details 发布后不再修改: 修改配置时拷贝一份、修改后整体替换(见LogSnapshot)，
+         * 因而写入记录的线程读到的各项配置总是同一次修改的结果
+         */
+        struct LogConfig
+        {
+            bool positionEnabled = true;                               ///< 是否允许显示log位置
+            bool positionFullpath = false;                             ///< 是否记录完整的文件名路径(positionEnabled为true时有效)
+            bool timeEnabled = true;                                   ///< 是否允许显示log时间
+            TimeFormat timeFormat = TimeFormat::LOCAL;                 ///< log时间的格式
+            TimePrecision timePrecision = TimePrecision::MILLISECOND;  ///< log时间秒以下部分的精度
+            std::shared_ptr<LogSink> sink = ConsoleSink::instance();   ///< 输出目标
+            FlushPolicy flushPolicy;                                   ///< 刷新策略
+        };
+
         /**
          * @class cf::utils::Log
          * @details 一个小巧灵活、线程安全的Log工具;主要特性如下：
@@ -107,14 +212,27 @@ namespace cf
          * 4. 支持C++的<<流式操作
          * 5. 支持可变参数列表格式化输出
          * 6. 支持输出到标准输出、文件输出(可选择覆盖或追加)
-         * 7. 支持在运行时切换输出文件
+         * 7. 支持在运行时切换输出文件，支持按大小/时间自动滚动并在后台压缩历史文件
          * 8. 支持DEBUG模式和非DEBUG模式(通过检查TRACE_ENABLED宏是否定义来区分这两种模式);在非DEBUG模式下，DLOG*系列的宏不会产生额外代码
          * 9. 可控制是否显示文件名、行位置
-         * 10. ...
+         * 10. 支持"{}"风格、编译期检查参数个数的类型安全格式化(LOG*_FMT宏)
+         * 11. 支持异步模式: 调用线程仅把记录放入无锁队列，由后台线程写入输出流;以及线程局部暂存、整块合并写入的暂存模式
+         * 12. 支持二进制(延迟格式化)log，由cflog-decode工具事后转为文本
+         * 13. 支持同时输出到多个目标(控制台、文件、滚动文件、内存环形缓冲、回调)，各目标有独立的等级阈值和格式化器
+         * 14. 支持带类型的键值字段(LogStream::kv())，可编码为JSON Lines或紧凑的二进制记录
+         * 15. 支持飞行记录仪: 在内存中保留各线程最近的全部记录，在FATAL或崩溃时写出
+         * 16. 支持按调用点的限速(令牌桶)，被丢弃的记录数合并报告
+         * 17. 支持编译期最低等级(CFLOG_MIN_LEVEL)，调用点信息在编译期生成
+         * 18. 支持线程局部的上下文字段(LogContext)，自动附加到本线程的每条记录
+         * 19. 支持作用域计时(TRACE_SCOPE)，输出为带耗时的log记录或Chrome trace-event JSON
+         * 20. 支持经共享内存把记录交给独立的收集进程(cflogd)写入文件
+         * 21. ...
          */
         class Log
         {
             friend class LogStream;
+            friend class AsyncWriter;
+            friend class StagingWriter;
 
         public:
             /**
@@ -152,15 +270,25 @@ namespace cf
             /**
              * @brief 操作符()方式写入log信息.
              * 
+             * @details 不修改Log对象的任何状态，多个线程可以同时使用同一个Log对象
+             *
              * @param[in] level 指定Log等级
+             * @param[in] logTag TAG字符串(只在本次调用中使用，不会被保存)
              * @return 返回LogStream对象
              * @see  cf::utils::LogLevel
              * @sa cf::utils::LogStream
              */
-            LogStream operator()(LogLevel level = LogLevel::INFO, std::string logTag=LOG_TAG)
+            LogStream operator()(LogLevel level = LogLevel::INFO, const char *logTag = LOG_TAG)
+            {
+                return createLogStream(level, logTag, "", 0);
+            }
+
+            /**
+             * @brief 操作符()方式写入log信息(TAG为std::string)
+             */
+            LogStream operator()(LogLevel level, const std::string &logTag)
             {
-                _tag = logTag;
-                return createLogStream(level, _tag, "", 0);
+                return createLogStream(level, logTag.c_str(), "", 0);
             }
 
             /**
@@ -174,7 +302,63 @@ namespace cf
              * @return LogStream 创建好的LogStream流对象
              * @see cf::utils::LogStream
              */
-            LogStream createLogStream(LogLevel curLevel, std::string tagString="", std::string srcFile = "", int srcLine = -1);
+            LogStream createLogStream(LogLevel curLevel, const char *tagString = "", const char *srcFile = "", int srcLine = -1);
+
+            /**
+             * @brief 创建LogStream对象(TAG与文件名为std::string)
+             */
+            LogStream createLogStream(LogLevel curLevel, const std::string &tagString, const std::string &srcFile = "", int srcLine = -1)
+            {
+                return createLogStream(curLevel, tagString.c_str(), srcFile.c_str(), srcLine);
+            }
+
+            /**
+             * @brief 按调用点信息创建LogStream对象(供LOG*宏使用).
+             * @details 调用点的TAG、文件名、行号与等级字符串均已在编译期算好，这里只拷贝字节
+             * 
+             * @param[in] site 调用点
+             * @return LogStream 创建好的LogStream流对象
+             * @see cf::utils::LogSite
+             */
+            LogStream createLogStream(const LogSite &site);
+
+            /**
+             * @brief 写入一条二进制(延迟格式化)记录，供LOG*_BIN宏使用.
+             * @details 设置了二进制log文件时只写入调用点编号、时间戳与参数的原始字节; 否则按"{}"格式输出文本记录
+             * 
+             * @param[in] site 调用点
+             * @param[in] args 参数
+             * @see cf::utils::BinaryLog
+             */
+            template <typename... Args>
+            void logBinary(BinaryLogSite &site, const FormatArgs<Args...> &args)
+            {
+                if (_binary)
+                {
+                    _stats.emitted(site.level);
+                    _binary->write(site, args);
+                    if (site.level == LogLevel::FATAL)
+                    {
+                        _binary->flush();
+#if !defined(_WIN32) && !defined(_WIN64)
+                        FlightRecorderSink::dumpAll("fatal");
+#endif
+                        fatal();
+                    }
+                    return;
+                }
+                createLogStream(site.level, site.tag) << args;
+            }
+
+            /**
+             * @brief 设定二进制log文件.
+             * @details 设定后LOG*_BIN宏的记录写入该文件(由cflog-decode工具或BinaryLog::decode()转为文本);
+             * 其它log宏不受影响
+             * @attention 应在开始log之前(或确定没有其它线程正在log时)调用
+             * 
+             * @param[in] file 二进制log文件，为空时关闭二进制log
+             */
+            void setBinaryLogFile(const std::string &file);
 
             /**
              * @brief 设定log文件及写入模式。若file为空，则改为默认的std::cout输出
@@ -184,6 +368,28 @@ namespace cf
              */
             void setLogFile(std::string file = "", bool append = false);
 
+            /**
+             * @brief 设定log的输出目标.
+             * @details 只等待本Log对象正在进行的写入完成，不会阻塞写其它目标的Log对象
+             * 
+             * @param[in] sink 输出目标，为空时改为默认的std::cout输出
+             * @see cf::utils::LogSink
+             */
+            void setLogSink(std::shared_ptr<LogSink> sink);
+
+            /**
+             * @brief 增加一个输出目标.
+             * @details 当前输出目标不是MultiSink时，先把它放入一个新的MultiSink(接收所有等级);
+             * 之后每条记录只格式化一次，再按各目标的阈值和格式化器分发
+             * @attention Log的阈值等级(setLogLevel())仍对所有目标生效
+             * 
+             * @param[in] sink 输出目标
+             * @param[in] minLevel 该目标只接收不低于此等级的记录
+             * @param[in] formatter 该目标的格式化器，为空时原样输出
+             * @see cf::utils::MultiSink
+             */
+            void addLogSink(std::shared_ptr<LogSink> sink, LogLevel minLevel = LogLevel::INFO, std::shared_ptr<LogFormatter> formatter = nullptr);
+
             /**
              * @brief 设置log的阈值等级.
              * 
@@ -192,6 +398,91 @@ namespace cf
              */
             void setLogLevel(LogLevel level);
 
+            /**
+             * @brief 判断指定等级的log是否会被记录.
+             * @details 仅为一次原子读操作，LOG*宏在构造LogStream、格式化参数之前先调用它
+             * 
+             * @param[in] level log等级
+             * @return true 会被记录; false 会被过滤掉
+             */
+            bool isLevelEnabled(LogLevel level) const
+            {
+                return level >= _level.load(std::memory_order_relaxed);
+            }
+
+            /**
+             * @brief 判断指定等级的log是否会被记录，被过滤掉时按需计入统计(见enableFilteredStats())
+             * 
+             * @param[in] level log等级
+             * @return true 会被记录; false 会被过滤掉
+             */
+            bool checkLevel(LogLevel level)
+            {
+                if (isLevelEnabled(level))
+                    return true;
+                if (_filteredStats.load(std::memory_order_relaxed))
+                    _stats.filtered(level);
+                return false;
+            }
+
+            /**
+             * @brief 设置全局的按调用点限速.
+             * @details 每个log调用点各自限速: 每秒最多放行perSecond条，允许burst条的突发;
+             * 被丢弃的记录数在该调用点下一条被放行的记录上以suppressed=N字段报告;一直没有被放行的，
+             * 由flush()及定期的运行统计(setStatsInterval())以该调用点的一条记录报告.
+             * LOGL_LIMIT/TRACEL_LIMIT宏可为单个调用点指定不同的限速
+             * 
+             * @param[in] perSecond 每秒放行的记录数，0表示不限速
+             * @param[in] burst 允许的突发记录数
+             * @see cf::utils::LogSiteLimiter
+             */
+            void setRateLimit(unsigned perSecond, unsigned burst = 10);
+
+            /**
+             * @brief 判断调用点的一条记录是否被限速放行.
+             * @details 由LOG*宏在构造LogStream之前调用;未设定限速时仅为一次原子读操作
+             * 
+             * @param[in] site 调用点
+             * @return true 放行; false 丢弃
+             */
+            bool admit(LogSite &site)
+            {
+                // 交给紧接着被调用的createLogStream()
+                _admittedSite = &site;
+
+                LogSiteLimiter &limiter = site.limiter;
+                unsigned perSecond = limiter.perSecond();
+                unsigned burst = limiter.burst();
+                if (perSecond == 0)
+                {
+                    perSecond = _ratePerSecond.load(std::memory_order_relaxed);
+                    burst = _rateBurst.load(std::memory_order_relaxed);
+                }
+                if (perSecond == 0 || perSecond == LogSiteLimiter::kUnlimited)
+                    return true;
+
+                uint64_t suppressed;
+                if (!limiter.admit(perSecond, burst, suppressed))
+                {
+                    _stats.dropped(site.level);
+                    // 每个调用点只登记一次，供reportSuppressed()报告此后一直没有被放行的记录
+                    if (!site.listed.load(std::memory_order_relaxed) && !site.listed.exchange(true))
+                        listLimitedSite(site);
+                    return false;
+                }
+                // 作为suppressed字段输出
+                _suppressedPending = suppressed;
+                return true;
+            }
+
+            /**
+             * @brief 调用线程最近一次被admit()放行的调用点，供LOG*宏把它交给createLogStream()
+             */
+            static const LogSite &admittedSite()
+            {
+                return *_admittedSite;
+            }
+
             /**
              * @brief 是否允许记录进行log的文件名和行号.
              * 
@@ -208,29 +499,119 @@ namespace cf
             void enableLogTime(bool timeLogged);
 
             /**
-             * @brief 调用log等级为FATAL的Log::log()时遇到致命错误的处理例程
-             * @attention 本类不进行任何操作，可由继承类重载并设定相应fatal动作(如abort())
-             * @todo 需要继承类支持用户自定义退出机制(如abort())
+             * @brief 设置log时间的格式与精度.
+             * 
+             * @param[in] format 时间戳格式
+             * @param[in] precision 秒以下部分的精度
+             * @see cf::utils::TimeFormat
+             * @see cf::utils::TimePrecision
              */
-            virtual void fatal();
+            void setTimeFormat(TimeFormat format, TimePrecision precision = TimePrecision::MILLISECOND);
 
             /**
-             * @brief 格式化字符串
+             * @brief 启用或关闭异步log模式.
+             * @details 异步模式下，LogStream析构时仅把记录放入有界无锁队列，由后台写线程负责写入输出流。
+             * 不低于urgentLevel的记录走单独的紧急通道，先于积压的低等级记录写出，且从不被丢弃;
+             * FATAL记录由调用线程在写完紧急通道后直接写入
+             * @attention 应在开始log之前(或确定没有其它线程正在log时)调用
              * 
-             * @param[in] format 字符串描述符
-             * @param[in] ... 可变长的参数列表
-             * @return std::string 格式化好后的字符串
+             * @param[in] enabled true:启用异步模式; false:写完队列中剩余记录后恢复同步模式
+             * @param[in] capacity 队列容量(记录条数)
+             * @param[in] policy 队列满时的处理策略(仅作用于低于urgentLevel的记录)
+             * @param[in] urgentLevel 走紧急通道的最低等级
+             * @see cf::utils::OverflowPolicy
+             * @see cf::utils::AsyncWriter
+             */
+            void enableAsync(bool enabled, size_t capacity = 8192, OverflowPolicy policy = OverflowPolicy::BLOCK, LogLevel urgentLevel = LogLevel::WARN);
+
+            /**
+             * @brief 启用或关闭线程局部暂存模式.
+             * @details 暂存模式下，各线程把记录追加到自己的暂存缓冲区，缓冲区写满(或滞留超过maxStalenessMs)后
+             * 整块交给后台线程，按时间戳合并排序后写入输出目标;与异步模式互斥，启用其中一个会关闭另一个
+             * @attention 应在开始log之前(或确定没有其它线程正在log时)调用
+             * 
+             * @param[in] enabled true:启用暂存模式; false:写完暂存的记录后恢复同步模式
+             * @param[in] bufferSize 每个线程暂存缓冲区的大小
+             * @param[in] maxStalenessMs 记录在暂存缓冲区中的最大滞留时间(毫秒)
+             * @param[in] maxPendingBuffers 已交付、待合并的缓冲区个数上限(合并跟不上时内存不再增长)
+             * @param[in] policy 达到上限时的处理策略
+             * @see cf::utils::OverflowPolicy
+             */
+            void enableStaging(bool enabled, size_t bufferSize = 64 * 1024, unsigned maxStalenessMs = 100, size_t maxPendingBuffers = 64, OverflowPolicy policy = OverflowPolicy::BLOCK);
+
+            /**
+             * @brief 设置输出目标的刷新策略.
+             * @details 默认每条记录刷新一次;批量刷新可大幅减少写文件的系统调用次数
+             * 
+             * @param[in] policy 刷新策略
+             * @see cf::utils::FlushPolicy
+             */
+            void setFlushPolicy(const FlushPolicy &policy);
+
+            /**
+             * @brief 等待所有已提交的log记录被写入输出流，并刷新输出流.
+             * 
+             */
+            void flush();
+
+            /**
+             * @brief 异步或暂存模式下因队列溢出而被丢弃的记录数.
+             * 
+             * @return uint64_t 被丢弃的记录数
+             */
+            uint64_t droppedCount() const;
+
+            /**
+             * @brief 获取Log自身的运行统计.
+             * @details 计数器始终开启(每条记录只做几次不争用的原子加);被过滤的记录数需先调用enableFilteredStats()，
+             * 延迟直方图需先调用enableLatencyStats()
+             * 
+             * @return LogStats 统计快照
+             * @see cf::utils::LogStats
+             */
+            LogStats stats();
+
+            /**
+             * @brief 是否统计提交与写入记录的耗时.
+             * @details 开启后每条记录多读取两到四次时钟
+             * 
+             * @param[in] enabled true:统计; false:不统计(默认)
+             */
+            void enableLatencyStats(bool enabled);
+
+            /**
+             * @brief 是否统计低于等级阈值而被过滤的记录数.
+             * @details 关闭时被过滤的语句只读取一次等级阈值;开启后每条被过滤的语句多做一次原子加
+             * 
+             * @param[in] enabled true:统计; false:不统计(默认)
+             */
+            void enableFilteredStats(bool enabled);
+
+            /**
+             * @brief 定期把运行统计作为一条log记录输出.
+             * @details 由后台线程每隔seconds秒以TAG "cflog"输出一条记录，统计值以键值字段附加在记录上(累计值)
+             * 
+             * @param[in] seconds 输出间隔(秒)，0表示停止输出
+             * @param[in] level 该记录的log等级
              */
-            static std::string formatString(char *format, ...);
+            void setStatsInterval(unsigned seconds, LogLevel level = LogLevel::NOTICE);
 
             /**
-             * @brief 格式化字符串
+             * @brief 调用log等级为FATAL的Log::log()时遇到致命错误的处理例程
+             * @attention 本类不进行任何操作，可由继承类重载并设定相应fatal动作(如abort())
+             * @todo 需要继承类支持用户自定义退出机制(如abort())
+             */
+            virtual void fatal();
+
+            /**
+             * @brief 格式化字符串(printf风格)
+             * @details 结果长度不受限制;新代码建议使用类型安全的LOG*_FMT宏
              * 
              * @param[in] format 字符串描述符
              * @param[in] ... 可变长的参数列表
              * @return std::string 格式化好后的字符串
              */
-            static std::string formatString(const char *format, ...);
+            static std::string formatString(const char *format, ...) CFLOG_PRINTF_FORMAT(1, 2);
 
         private:
             /**
@@ -253,7 +634,7 @@ namespace cf
             static void init();
 
             /**
-             * @brief 首先输出流内的数据，然后检查并关闭打开的文件.
+             * @brief 首先刷新输出目标，然后释放对它的引用(最后一个引用释放时关闭文件).
              * 
              */
             void cleanupStream();
@@ -265,14 +646,91 @@ namespace cf
              */
             void log(LogStream *ls);
 
+            /**
+             * @brief 把一条已格式化好的log记录写入输出流.
+             * 
+             * @param[in] rec log记录
+             * @param[in] capture 是否同时交给perThread()的输出目标(仅在产生记录的线程上、且尚未交过时为true)
+             */
+            void write(const LogRecordView &rec, bool capture = false);
+
+            /**
+             * @brief 在产生记录的线程上把记录交给perThread()的输出目标(异步/暂存模式下在入队之前调用)
+             */
+            void capture(const LogRecordView &rec);
+
+            /**
+             * @brief 等待异步队列/暂存缓冲中已提交的记录被写入输出目标
+             */
+            void flushPending();
+
+            /**
+             * @brief 按刷新策略判断写入一条记录后是否需要刷新
+             * 
+             * @param[in] policy 刷新策略
+             * @param[in] level 刚写入的记录的log等级
+             * @param[in] len 刚写入的记录的字节数
+             * @return true 需要刷新
+             */
+            bool needFlush(const FlushPolicy &policy, LogLevel level, size_t len);
+
+            /**
+             * @brief 定时刷新线程的主循环
+             */
+            void flushTimer();
+
+            /**
+             * @brief 停止定时刷新线程
+             */
+            void stopFlushTimer();
+
+            /**
+             * @brief 定期输出运行统计的线程的主循环
+             */
+            void statsTimer();
+
+            /**
+             * @brief 把调用点加入曾被限速的调用点链表(无锁，只增不减)
+             */
+            void listLimitedSite(LogSite &site);
+
+            /**
+             * @brief 为每个仍有未报告的被丢弃记录的调用点输出一条带suppressed=N字段的记录
+             */
+            void reportSuppressed();
+
+            /**
+             * @brief 停止定期输出运行统计的线程
+             */
+            void stopStatsTimer();
+
         private:
-            std::string _tag = LOG_TAG;            ///< Log Tag
-            LogLevel _level = LogLevel::INFO;      ///< Log阈值，当log动作对应的log等级必须大于或等于Log阈值，log信息才会被记录下来.
-            bool _positionEnabled = true;          ///< 是否允许显示log位置.
-            bool _positionFullpathEnabled = false; ///< 是否记录完整的文件名路径(此开关在_positionEanbled被启用的前提下有效)
-            bool _timeEnabled = true;              ///< 是否允许显示log时间
-            std::ostream *_os = nullptr;           ///< Log输出流.
-            std::ofstream _ofs;                    ///< Log文件对象
+            std::atomic<unsigned> _ratePerSecond{0};      ///< 全局的按调用点限速: 每秒放行的记录数，0表示不限速
+            std::atomic<unsigned> _rateBurst{10};         ///< 全局的按调用点限速: 允许的突发记录数
+            static thread_local uint64_t _suppressedPending; ///< admit()放行时，该调用点此前被丢弃的记录数
+            static thread_local LogSite *_admittedSite;     ///< admit()最近一次放行的调用点
+            std::atomic<LogSite *> _limitedSites{nullptr};  ///< 曾有记录被限速丢弃的调用点组成的链表
+            std::atomic<LogLevel> _level{LogLevel::INFO}; ///< Log阈值，当log动作对应的log等级必须大于或等于Log阈值，log信息才会被记录下来. 不放在配置快照中: 等级检查只需一次原子读，无需进入读区
+            LogSnapshot<LogConfig> _config;        ///< 配置快照: 写入记录时只进入读区，修改配置不会阻塞写入记录的线程
+            std::unique_ptr<AsyncWriter> _async;   ///< 异步写入器，为空时表示同步模式
+            std::unique_ptr<StagingWriter> _staging; ///< 线程局部暂存写入器，为空时表示未启用暂存模式
+            std::unique_ptr<BinaryLog> _binary;    ///< 二进制log文件，为空时LOG*_BIN宏输出文本
+            std::atomic<size_t> _unflushedRecords{0}; ///< 上次刷新后写入的记录数
+            std::atomic<size_t> _unflushedBytes{0};   ///< 上次刷新后写入的字节数
+            std::mutex _timerMutex;                ///< 定时刷新线程使用的互斥量
+            std::condition_variable _timerCond;    ///< 用于唤醒(停止)定时刷新线程
+            bool _timerStop = false;               ///< 是否停止定时刷新线程
+            std::thread _timerThread;              ///< 定时刷新线程
+            LogStatsCounters _stats;               ///< 运行统计
+            std::atomic<bool> _latencyStats{false}; ///< 是否统计耗时
+            std::atomic<bool> _filteredStats{false}; ///< 是否统计被过滤的记录数
+            std::atomic<bool> _captureSink{false}; ///< 当前输出目标是否可能需要capture()(perThread()的目标或MultiSink)
+            unsigned _statsInterval = 0;           ///< 定期输出运行统计的间隔(秒)
+            LogLevel _statsLevel = LogLevel::NOTICE; ///< 运行统计记录的log等级
+            std::mutex _statsMutex;                ///< 定期输出运行统计的线程使用的互斥量
+            std::condition_variable _statsCond;    ///< 用于唤醒(停止)定期输出运行统计的线程
+            bool _statsStop = false;               ///< 是否停止定期输出运行统计的线程
+            std::thread _statsThread;              ///< 定期输出运行统计的线程
 
         private:
             /**
@@ -288,12 +746,17 @@ namespace cf
              * 
              */
             static std::shared_ptr<Log> _ptr;
+        };
 
-            /** 
-             * @brief 确保log时线程安全的互斥量.
-             * @details 保证多线程环境下切换输出文件、多个Log实例同时写同一个log文件的操作完整性（不被打断）
-             */
-            static std::mutex _mutex;
+        /**
+         * @class cf::utils::LogVoidify
+         * @brief 供LOGL/TRACEL宏使用的辅助类，把"<<"表达式转为void，以便与条件运算符的(void)0分支匹配.
+         * @details "&"的优先级低于"<<"，因此LOGL(INFO) << a << b中的全部"<<"都在等级检查通过后才会被求值
+         */
+        class LogVoidify
+        {
+        public:
+            void operator&(const std::ostream &) {}
         };
 
         /**
@@ -305,6 +768,16 @@ namespace cf
          */
         void setLogLevel(LogLevel level);
 
+        /**
+         * @brief 设置全局的按调用点限速.
+         * 
+         * @param[in] perSecond 每秒放行的记录数，0表示不限速
+         * @param[in] burst 允许的突发记录数
+         * @attention 该全局函数用于单例模式Log
+         * @see cf::utils::Log::setRateLimit()
+         */
+        void setRateLimit(unsigned perSecond, unsigned burst = 10);
+
         /**
          * @brief 设定log文件及写入模式。若file为空，则改为默认的std::cout输出
          * 
@@ -315,6 +788,35 @@ namespace cf
          */
         void setLogFile(std::string file = "", bool append = true);
 
+        /**
+         * @brief 设定log的输出目标.
+         * 
+         * @param[in] sink 输出目标，为空时改为默认的std::cout输出
+         * @attention 该全局函数用于单例模式Log
+         * @see cf::utils::Log::setLogSink()
+         */
+        void setLogSink(std::shared_ptr<LogSink> sink);
+
+        /**
+         * @brief 增加一个输出目标.
+         * 
+         * @param[in] sink 输出目标
+         * @param[in] minLevel 该目标只接收不低于此等级的记录
+         * @param[in] formatter 该目标的格式化器，为空时原样输出
+         * @attention 该全局函数用于单例模式Log
+         * @see cf::utils::Log::addLogSink()
+         */
+        void addLogSink(std::shared_ptr<LogSink> sink, LogLevel minLevel = LogLevel::INFO, std::shared_ptr<LogFormatter> formatter = nullptr);
+
+        /**
+         * @brief 设定二进制log文件.
+         * 
+         * @param[in] file 二进制log文件，为空时关闭二进制log
+         * @attention 该全局函数用于单例模式Log
+         * @see cf::utils::Log::setBinaryLogFile()
+         */
+        void setBinaryLogFile(const std::string &file);
+
         /**
          * @brief 是否允许记录进行log的文件名和行号.
          * 
@@ -333,5 +835,89 @@ namespace cf
          * @see cf::utils::Log::enableLogTime()
          */
         void enableLogTime(bool timeLogged);
+
+        /**
+         * @brief 设置log时间的格式与精度.
+         * 
+         * @param[in] format 时间戳格式
+         * @param[in] precision 秒以下部分的精度
+         * @attention 该全局函数用于单例模式Log
+         * @see cf::utils::Log::setTimeFormat()
+         */
+        void setTimeFormat(TimeFormat format, TimePrecision precision = TimePrecision::MILLISECOND);
+
+        /**
+         * @brief 启用或关闭异步log模式.
+         * 
+         * @param[in] enabled true:启用异步模式; false:恢复同步模式
+         * @param[in] capacity 队列容量(记录条数)
+         * @param[in] policy 队列满时的处理策略(仅作用于低于urgentLevel的记录)
+         * @param[in] urgentLevel 走紧急通道的最低等级
+         * @attention 该全局函数用于单例模式Log
+         * @see cf::utils::Log::enableAsync()
+         */
+        void enableAsync(bool enabled, size_t capacity = 8192, OverflowPolicy policy = OverflowPolicy::BLOCK, LogLevel urgentLevel = LogLevel::WARN);
+
+        /**
+         * @brief 启用或关闭线程局部暂存模式.
+         * 
+         * @param[in] enabled true:启用暂存模式; false:恢复同步模式
+         * @param[in] bufferSize 每个线程暂存缓冲区的大小
+         * @param[in] maxStalenessMs 记录在暂存缓冲区中的最大滞留时间(毫秒)
+         * @param[in] maxPendingBuffers 已交付、待合并的缓冲区个数上限
+         * @param[in] policy 达到上限时的处理策略
+         * @attention 该全局函数用于单例模式Log
+         * @see cf::utils::Log::enableStaging()
+         */
+        void enableStaging(bool enabled, size_t bufferSize = 64 * 1024, unsigned maxStalenessMs = 100, size_t maxPendingBuffers = 64, OverflowPolicy policy = OverflowPolicy::BLOCK);
+
+        /**
+         * @brief 设置输出目标的刷新策略.
+         * 
+         * @param[in] policy 刷新策略
+         * @attention 该全局函数用于单例模式Log
+         * @see cf::utils::Log::setFlushPolicy()
+         */
+        void setFlushPolicy(const FlushPolicy &policy);
+
+        /**
+         * @brief 等待所有已提交的log记录被写入输出流，并刷新输出流.
+         * 
+         * @attention 该全局函数用于单例模式Log
+         * @see cf::utils::Log::flush()
+         */
+        void flushLog();
+
+        /**
+         * @brief 获取Log自身的运行统计.
+         * 
+         * @attention 该全局函数用于单例模式Log
+         * @see cf::utils::Log::stats()
+         */
+        LogStats logStats();
+
+        /**
+         * @brief 是否统计提交与写入记录的耗时.
+         * 
+         * @attention 该全局函数用于单例模式Log
+         * @see cf::utils::Log::enableLatencyStats()
+         */
+        void enableLatencyStats(bool enabled);
+
+        /**
+         * @brief 是否统计低于等级阈值而被过滤的记录数.
+         * 
+         * @attention 该全局函数用于单例模式Log
+         * @see cf::utils::Log::enableFilteredStats()
+         */
+        void enableFilteredStats(bool enabled);
+
+        /**
+         * @brief 定期把运行统计作为一条log记录输出.
+         * 
+         * @attention 该全局函数用于单例模式Log
+         * @see cf::utils::Log::setStatsInterval()
+         */
+        void setStatsInterval(unsigned seconds, LogLevel level = LogLevel::NOTICE);
     };
 };
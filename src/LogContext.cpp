@@ -0,0 +1,13 @@
+#include "LogContext.h"
+
+namespace cf
+{
+    namespace utils
+    {
+        std::string &LogContext::buffer()
+        {
+            thread_local std::string context;
+            return context;
+        }
+    };
+};
@@ -0,0 +1,89 @@
+/**
+ * @file LogContext.h
+ * @author Genleung Lan (genleung@hotmail.com)
+ * @brief 线程局部的上下文字段(MDC)
+ * @version 0.1
+ * @date 2021-07-31
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#pragma once
+#include <sstream>
+#include <string>
+#include "LogFields.h"
+
+namespace cf
+{
+    namespace utils
+    {
+        /**
+         * @class cf::utils::LogContext
+         * @brief 作用域内的上下文字段: 本线程此后的每条记录都自动带上该字段.
+         * @details 各线程的上下文字段预先以LogFieldWriter的格式编码在一块线程局部的缓冲区中，只在LogContext构造、析构时改变;
+         * 每条记录仅把这块缓冲区整体拷贝到其字段之前(一次memcpy)，不再逐次格式化。
+         * 上下文字段与kv()添加的字段一样由各输出目标输出(文本为" key=value"，JSON Lines为同名的键)，排在kv()字段之前.
+         * 嵌套的作用域按后进先出的顺序撤销;同名的键不会覆盖外层的字段，而是同时输出
+         * @attention 只作用于构造它的线程，必须在同一线程内析构;异步/暂存模式下字段在提交记录时已拷贝，不受其后撤销的影响
+         *
+         *     void handle(const Request &req)
+         *     {
+         *         LogContext ctx("req_id", req.id);
+         *         LOGI("start");          // [I]... start req_id=42
+         *     }
+         */
+        class LogContext
+        {
+        public:
+            /**
+             * @brief 构造函数，把字段追加到本线程的上下文中
+             *
+             * @param[in] key 键(超过255字节时被截断)
+             * @param[in] value 值;整数、浮点数、布尔值与字符串按原类型保存，其它类型经operator<<转为字符串
+             */
+            template <typename T>
+            LogContext(const char *key, const T &value)
+                : _mark(buffer().size())
+            {
+                append(key, value, std::integral_constant<bool, LogFieldWriter::isEncodable<T>::value>());
+            }
+
+            /**
+             * @brief 析构函数，从本线程的上下文中撤销本对象添加的字段
+             */
+            ~LogContext() { buffer().resize(_mark); }
+
+            LogContext(const LogContext &) = delete;
+            LogContext &operator=(const LogContext &) = delete;
+
+            /**
+             * @brief 本线程当前的上下文字段(已编码)，为空表示没有上下文
+             */
+            static const std::string &current() { return buffer(); }
+
+        private:
+            template <typename T>
+            void append(const char *key, const T &value, std::true_type)
+            {
+                std::stringbuf sb;
+                LogFieldWriter::write(&sb, key, value);
+                buffer() += sb.str();
+            }
+
+            template <typename T>
+            void append(const char *key, const T &value, std::false_type)
+            {
+                std::ostringstream os;
+                os << value;
+                append(key, os.str(), std::true_type());
+            }
+
+            /// 本线程的上下文缓冲区
+            static std::string &buffer();
+
+        private:
+            size_t _mark; ///< 构造前缓冲区的长度，析构时恢复到该长度
+        };
+    };
+};
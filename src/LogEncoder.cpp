@@ -0,0 +1,210 @@
+#include "LogEncoder.h"
+#include "Log.h"
+#include <cmath>
+#include <cstring>
+#include <istream>
+#include <ostream>
+
+namespace cf
+{
+    namespace utils
+    {
+        namespace
+        {
+            const char *levelName(LogLevel level)
+            {
+                const static char *names[] = {"INFO", "NOTICE", "WARN", "ERROR", "FATAL"};
+                return names[(int)level];
+            }
+
+            void appendMember(std::string &out, const char *key, size_t keyLen, const char *data, size_t len)
+            {
+                out += ',';
+                JsonLinesEncoder::appendString(out, key, keyLen);
+                out += ':';
+                JsonLinesEncoder::appendString(out, data, len);
+            }
+
+            void appendU32(std::string &out, uint32_t v)
+            {
+                out.append((const char *)&v, 4);
+            }
+
+            void appendBytes(std::string &out, const char *data, size_t len)
+            {
+                appendU32(out, (uint32_t)len);
+                out.append(data, len);
+            }
+
+            bool readU32(const char *&p, const char *end, uint32_t &v)
+            {
+                if (end - p < 4)
+                    return false;
+                std::memcpy(&v, p, 4);
+                p += 4;
+                return true;
+            }
+
+            bool readBytes(const char *&p, const char *end, const char *&data, size_t &len)
+            {
+                uint32_t n;
+                if (!readU32(p, end, n) || (size_t)(end - p) < n)
+                    return false;
+                data = p;
+                len = n;
+                p += n;
+                return true;
+            }
+        }
+
+        void JsonLinesEncoder::appendString(std::string &out, const char *data, size_t len)
+        {
+            static const char hex[] = "0123456789abcdef";
+            out += '"';
+            const char *run = data;
+            for (size_t i = 0; i < len; i++)
+            {
+                unsigned char c = (unsigned char)data[i];
+                if (c >= 0x20 && c != '"' && c != '\\')
+                    continue;
+
+                // 连续的普通字符整段拷贝
+                out.append(run, data + i - run);
+                run = data + i + 1;
+                switch (c)
+                {
+                case '"':
+                    out.append("\\\"", 2);
+                    break;
+                case '\\':
+                    out.append("\\\\", 2);
+                    break;
+                case '\n':
+                    out.append("\\n", 2);
+                    break;
+                case '\r':
+                    out.append("\\r", 2);
+                    break;
+                case '\t':
+                    out.append("\\t", 2);
+                    break;
+                default:
+                    out.append("\\u00", 4);
+                    out += hex[c >> 4];
+                    out += hex[c & 0xf];
+                    break;
+                }
+            }
+            out.append(run, data + len - run);
+            out += '"';
+        }
+
+        void JsonLinesEncoder::format(const LogRecordView &rec, std::string &out)
+        {
+            const LogRecordLayout &l = rec.layout;
+            out.append("{\"level\":\"", 10);
+            out.append(levelName(rec.level));
+            out += '"';
+            if (l.timeLength)
+                appendMember(out, "time", 4, rec.text + l.timeOffset, l.timeLength);
+            if (l.tagLength)
+                appendMember(out, "tag", 3, rec.text + l.tagOffset, l.tagLength);
+            if (l.posLength)
+                appendMember(out, "pos", 3, rec.text + l.posOffset, l.posLength);
+            appendMember(out, "msg", 3, rec.text + l.messageOffset, rec.textLength - l.messageOffset);
+
+            LogFieldReader reader(rec.fields, rec.fieldsLength);
+            LogField f;
+            while (reader.next(f))
+            {
+                out += ',';
+                appendString(out, f.key, f.keyLength);
+                out += ':';
+                if (f.type == LogFieldType::STRING)
+                    appendString(out, f.str, f.strLength);
+                else if (f.type == LogFieldType::DOUBLE && !std::isfinite(f.d))
+                    out.append("null", 4);
+                else
+                    LogFieldReader::appendScalar(out, f);
+            }
+            out += '}';
+        }
+
+        void BinaryRecordEncoder::format(const LogRecordView &rec, std::string &out)
+        {
+            const LogRecordLayout &l = rec.layout;
+            appendU32(out, 0); // 负载长度，最后回填
+            out += (char)rec.level;
+            appendBytes(out, rec.text + l.tagOffset, l.tagLength);
+            appendBytes(out, rec.text + l.timeOffset, l.timeLength);
+            appendBytes(out, rec.text + l.posOffset, l.posLength);
+            appendBytes(out, rec.text + l.messageOffset, rec.textLength - l.messageOffset);
+            appendBytes(out, rec.fields, rec.fieldsLength);
+
+            uint32_t n = (uint32_t)(out.size() - 4);
+            std::memcpy(&out[0], &n, 4);
+        }
+
+        bool BinaryRecordReader::next(BinaryRecord &rec)
+        {
+            const char *p = _p;
+            const char *payload;
+            size_t len;
+            if (!readBytes(p, _end, payload, len) || len < 1 || (unsigned char)payload[0] > (unsigned char)LogLevel::FATAL)
+                return false;
+
+            // 负载内的各部分不得越出负载
+            const char *q = payload + 1;
+            const char *end = payload + len;
+            rec.level = (LogLevel)payload[0];
+            if (!readBytes(q, end, rec.tag, rec.tagLength) ||
+                !readBytes(q, end, rec.time, rec.timeLength) ||
+                !readBytes(q, end, rec.pos, rec.posLength) ||
+                !readBytes(q, end, rec.message, rec.messageLength) ||
+                !readBytes(q, end, rec.fields, rec.fieldsLength) || q != end)
+                return false;
+            _p = p;
+            return true;
+        }
+
+        bool BinaryRecordReader::decode(std::istream &in, std::ostream &out)
+        {
+            const static char *levelStr[] = {"[I]", "[N]", "[W]", "[E]", "[F]"};
+
+            std::string frame;
+            std::string line;
+            uint32_t n;
+            while (in.read((char *)&n, 4))
+            {
+                frame.resize(4 + (size_t)n);
+                std::memcpy(&frame[0], &n, 4);
+                if (!in.read(&frame[4], n))
+                    return false;
+
+                BinaryRecordReader reader(frame.data(), frame.size());
+                BinaryRecord rec;
+                if (!reader.next(rec))
+                    return false;
+
+                line = levelStr[(int)rec.level];
+                const char *parts[] = {rec.tag, rec.time, rec.pos};
+                const size_t lengths[] = {rec.tagLength, rec.timeLength, rec.posLength};
+                for (int i = 0; i < 3; i++)
+                {
+                    if (lengths[i] == 0)
+                        continue;
+                    line += '[';
+                    line.append(parts[i], lengths[i]);
+                    line += ']';
+                }
+                line += ' ';
+                line.append(rec.message, rec.messageLength);
+                LogFieldReader::appendText(line, rec.fields, rec.fieldsLength);
+                line += '\n';
+                out.write(line.data(), line.size());
+            }
+            // 正常结束时恰好读完最后一条记录，不应剩下不足4字节的残片
+            return in.gcount() == 0;
+        }
+    };
+};
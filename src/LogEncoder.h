@@ -0,0 +1,117 @@
+/**
+ * @file LogEncoder.h
+ * @author Genleung Lan (genleung@hotmail.com)
+ * @brief 结构化记录的编码器: JSON Lines与紧凑二进制格式
+ * @version 0.1
+ * @date 2021-07-31
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#pragma once
+#include <iosfwd>
+#include <string>
+#include "MultiSink.h"
+
+namespace cf
+{
+    namespace utils
+    {
+        /**
+         * @class cf::utils::JsonLinesEncoder
+         * @brief 把记录编码为一行JSON.
+         * @details 输出形如{"level":"INFO","time":"...","tag":"...","pos":"file:line","msg":"...","key":value,...};
+         * 不存在的前缀部分不输出。字段按类型输出为JSON的布尔值、数字或字符串，NaN与无穷大输出为null。
+         * 直接引用记录文本中的片段，编码结果写入MultiSink复用的字符串，不产生其它中间分配
+         */
+        class JsonLinesEncoder : public LogFormatter
+        {
+        public:
+            void format(const LogRecordView &rec, std::string &out) override;
+
+            /**
+             * @brief 把一段字节作为JSON字符串(含双引号)追加到out
+             */
+            static void appendString(std::string &out, const char *data, size_t len);
+        };
+
+        /**
+         * @class cf::utils::BinaryRecordEncoder
+         * @brief 把记录编码为紧凑的、带长度前缀的二进制格式.
+         * @details 每条记录为: 负载长度(uint32) + 负载，负载依次为:
+         * 等级(1字节)、TAG、时间、"文件名:行号"、消息正文(各为uint32长度 + 字节)、字段(uint32长度 + LogFieldWriter编码的字段)。
+         * 整数均为本机字节序。记录经LogSink::writeBytes()首尾相接地写出，其间没有分隔符;
+         * 可用BinaryRecordReader读取
+         */
+        class BinaryRecordEncoder : public LogFormatter
+        {
+        public:
+            void format(const LogRecordView &rec, std::string &out) override;
+            bool binary() const override { return true; }
+        };
+
+        /**
+         * @brief 解码得到的一条二进制记录.
+         * @details 各指针引用编码数据，不持有之
+         */
+        struct BinaryRecord
+        {
+            LogLevel level;           ///< log等级
+            const char *tag;          ///< TAG
+            size_t tagLength;         ///< TAG的长度
+            const char *time;         ///< 时间
+            size_t timeLength;        ///< 时间的长度
+            const char *pos;          ///< "文件名:行号"
+            size_t posLength;         ///< "文件名:行号"的长度
+            const char *message;      ///< 消息正文
+            size_t messageLength;     ///< 消息正文的长度
+            const char *fields;       ///< LogFieldWriter编码的字段，可用LogFieldReader解码
+            size_t fieldsLength;      ///< 字段的字节数
+        };
+
+        /**
+         * @class cf::utils::BinaryRecordReader
+         * @brief 逐条解码BinaryRecordEncoder输出的记录
+         */
+        class BinaryRecordReader
+        {
+        public:
+            /**
+             * @brief 构造函数
+             * 
+             * @param[in] data 编码后的记录(一条或多条首尾相接)
+             * @param[in] len 字节数
+             */
+            BinaryRecordReader(const char *data, size_t len) : _p(data), _end(data + len) {}
+
+            /**
+             * @brief 解码下一条记录
+             * 
+             * @param[out] rec 解码结果
+             * @return true 成功
+             * @return false 已没有记录(或数据不完整，见atEnd())
+             */
+            bool next(BinaryRecord &rec);
+
+            /**
+             * @brief 是否已读完全部数据(next()返回false时据此区分正常结束与数据不完整)
+             */
+            bool atEnd() const { return _p == _end; }
+
+            /**
+             * @brief 把BinaryRecordEncoder的输出解码为文本log.
+             * @details 每条记录输出为一行: [I][TAG][时间][文件名:行号] 消息正文，字段以" key=value"的形式追加在其后
+             * 
+             * @param[in] in 二进制输入流
+             * @param[out] out 文本输出流
+             * @return true 解码成功; false 数据不完整或格式有误(已解码的部分仍会输出)
+             */
+            static bool decode(std::istream &in, std::ostream &out);
+
+        private:
+            const char *_p;   ///< 当前位置
+            const char *_end; ///< 结束位置
+        };
+    };
+};
@@ -0,0 +1,157 @@
+#include "LogFields.h"
+#include <cstdio>
+
+namespace cf
+{
+    namespace utils
+    {
+        bool LogFieldReader::next(LogField &field)
+        {
+            if (_end - _p < 2)
+                return false;
+            const char *p = _p;
+            field.type = (LogFieldType)p[0];
+            field.keyLength = (unsigned char)p[1];
+            field.key = p + 2;
+            p += 2 + field.keyLength;
+            if (p > _end)
+                return false;
+
+            switch (field.type)
+            {
+            case LogFieldType::BOOL:
+                if (_end - p < 1)
+                    return false;
+                field.b = *p != 0;
+                p += 1;
+                break;
+            case LogFieldType::INT:
+                if (_end - p < 8)
+                    return false;
+                std::memcpy(&field.i, p, 8);
+                p += 8;
+                break;
+            case LogFieldType::UINT:
+                if (_end - p < 8)
+                    return false;
+                std::memcpy(&field.u, p, 8);
+                p += 8;
+                break;
+            case LogFieldType::DOUBLE:
+                if (_end - p < 8)
+                    return false;
+                std::memcpy(&field.d, p, 8);
+                p += 8;
+                break;
+            case LogFieldType::STRING:
+            {
+                if (_end - p < 4)
+                    return false;
+                uint32_t n;
+                std::memcpy(&n, p, 4);
+                p += 4;
+                if ((size_t)(_end - p) < n)
+                    return false;
+                field.str = p;
+                field.strLength = n;
+                p += n;
+                break;
+            }
+            default:
+                return false;
+            }
+            _p = p;
+            return true;
+        }
+
+        void LogFieldReader::appendScalar(std::string &out, const LogField &field)
+        {
+            char buf[32];
+            char *end = buf + sizeof(buf);
+            char *p = end;
+            switch (field.type)
+            {
+            case LogFieldType::BOOL:
+                if (field.b)
+                    out.append("true", 4);
+                else
+                    out.append("false", 5);
+                return;
+            case LogFieldType::INT:
+            case LogFieldType::UINT:
+            {
+                bool negative = field.type == LogFieldType::INT && field.i < 0;
+                uint64_t u = field.type == LogFieldType::INT ? (uint64_t)field.i : field.u;
+                if (negative)
+                    u = 0 - u;
+                do
+                {
+                    *--p = (char)('0' + u % 10);
+                    u /= 10;
+                } while (u);
+                if (negative)
+                    *--p = '-';
+                out.append(p, end - p);
+                return;
+            }
+            case LogFieldType::DOUBLE:
+            {
+                // 保证解析回来的值与原值相同
+                int n = std::snprintf(buf, sizeof(buf), "%.17g", field.d);
+                out.append(buf, n);
+                return;
+            }
+            default:
+                return;
+            }
+        }
+
+        void LogFieldReader::appendText(std::string &out, const char *data, size_t len)
+        {
+            LogFieldReader reader(data, len);
+            LogField f;
+            while (reader.next(f))
+            {
+                out += ' ';
+                out.append(f.key, f.keyLength);
+                out += '=';
+                if (f.type != LogFieldType::STRING)
+                {
+                    appendScalar(out, f);
+                    continue;
+                }
+
+                bool quoted = f.strLength == 0;
+                for (size_t i = 0; i < f.strLength && !quoted; i++)
+                {
+                    char c = f.str[i];
+                    quoted = (unsigned char)c <= ' ' || c == '=' || c == '"';
+                }
+                if (!quoted)
+                {
+                    out.append(f.str, f.strLength);
+                    continue;
+                }
+                out += '"';
+                for (size_t i = 0; i < f.strLength; i++)
+                {
+                    // 换行符等被转义，保证一条记录仍只占一行
+                    char c = f.str[i];
+                    if (c == '\n')
+                        out.append("\\n", 2);
+                    else if (c == '\r')
+                        out.append("\\r", 2);
+                    else if (c == '\t')
+                        out.append("\\t", 2);
+                    else
+                    {
+                        if (c == '"' || c == '\\')
+                            out += '\\';
+                        out += c;
+                    }
+                }
+                out += '"';
+            }
+        }
+    };
+};
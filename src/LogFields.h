@@ -0,0 +1,223 @@
+/**
+ * @file LogFields.h
+ * @author Genleung Lan (genleung@hotmail.com)
+ * @brief 结构化log记录: 带类型的键值字段
+ * @version 0.1
+ * @date 2021-07-31
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <type_traits>
+
+namespace cf
+{
+    namespace utils
+    {
+        enum class LogLevel;
+
+        /**
+         * @brief 记录前缀中各部分在文本中的位置.
+         * @details 由Log::createLogStream()在写前缀时填写，供JSON等编码器直接引用文本中的片段，无需再解析;
+         * 长度为0表示该部分不存在
+         */
+        struct LogRecordLayout
+        {
+            uint32_t tagOffset = 0;     ///< TAG(不含方括号)的偏移
+            uint32_t tagLength = 0;     ///< TAG的长度
+            uint32_t timeOffset = 0;    ///< 时间(不含方括号)的偏移
+            uint32_t timeLength = 0;    ///< 时间的长度
+            uint32_t posOffset = 0;     ///< "文件名:行号"(不含方括号)的偏移
+            uint32_t posLength = 0;     ///< "文件名:行号"的长度
+            uint32_t messageOffset = 0; ///< 消息正文的偏移
+        };
+
+        /**
+         * @brief 一条log记录: 文本部分与编码后的结构化字段.
+         * @details 仅引用数据，不持有之;在LogSink::writeRecord()返回后即失效
+         */
+        struct LogRecordView
+        {
+            LogLevel level;           ///< log等级
+            const char *text;         ///< 文本记录(前缀 + 消息正文，不含换行符)
+            size_t textLength;        ///< 文本记录的字节数
+            const char *fields;       ///< 编码后的字段，见LogFieldWriter
+            size_t fieldsLength;      ///< 字段的字节数，0表示没有字段
+            LogRecordLayout layout;   ///< 前缀各部分的位置
+        };
+
+        /**
+         * @brief 字段值的类型.
+         */
+        enum class LogFieldType : char
+        {
+            BOOL = 'b',   ///< 布尔值(1字节)
+            INT = 'i',    ///< 有符号整数(int64_t)
+            UINT = 'u',   ///< 无符号整数(uint64_t)
+            DOUBLE = 'd', ///< 浮点数(double)
+            STRING = 's'  ///< 字符串(uint32_t长度 + 字节)
+        };
+
+        /**
+         * @brief 解码得到的一个字段.
+         * @details key与str引用编码数据，不持有之
+         */
+        struct LogField
+        {
+            const char *key;     ///< 键
+            size_t keyLength;    ///< 键的长度
+            LogFieldType type;   ///< 值的类型
+            bool b = false;      ///< BOOL类型的值
+            int64_t i = 0;       ///< INT类型的值
+            uint64_t u = 0;      ///< UINT类型的值
+            double d = 0;        ///< DOUBLE类型的值
+            const char *str = nullptr; ///< STRING类型的值
+            size_t strLength = 0;      ///< STRING类型的值的长度
+        };
+
+        /**
+         * @class cf::utils::LogFieldWriter
+         * @brief 把键值对编码后追加到缓冲区.
+         * @details 每个字段的编码为: 类型(1字节) + 键长(1字节) + 键 + 值;
+         * 整数与浮点数按本机字节序存放8字节，字符串为4字节长度加内容。键超过255字节时被截断.
+         * 值直接写入流缓冲区，不产生中间std::string
+         */
+        class LogFieldWriter
+        {
+        public:
+            /// T能否被write()直接编码;其它类型需经operator<<转为字符串
+            template <typename T>
+            struct isEncodable
+            {
+                static const bool value = std::is_arithmetic<T>::value || std::is_convertible<T, const char *>::value || std::is_same<T, std::string>::value;
+            };
+
+            static void write(std::streambuf *sb, const char *key, bool v)
+            {
+                writeKey(sb, LogFieldType::BOOL, key);
+                sb->sputc(v ? 1 : 0);
+            }
+
+            static void write(std::streambuf *sb, const char *key, char v)
+            {
+                write(sb, key, &v, 1);
+            }
+
+            static void write(std::streambuf *sb, const char *key, const char *v)
+            {
+                if (v == nullptr)
+                    v = "(null)";
+                write(sb, key, v, std::strlen(v));
+            }
+
+            static void write(std::streambuf *sb, const char *key, const std::string &v)
+            {
+                write(sb, key, v.data(), v.size());
+            }
+
+            static void write(std::streambuf *sb, const char *key, const char *v, size_t len)
+            {
+                writeKey(sb, LogFieldType::STRING, key);
+                uint32_t n = (uint32_t)len;
+                sb->sputn((const char *)&n, 4);
+                sb->sputn(v, n);
+            }
+
+            /// 有符号整数
+            template <typename T>
+            static typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value && !std::is_same<T, char>::value>::type
+            write(std::streambuf *sb, const char *key, T v)
+            {
+                writeKey(sb, LogFieldType::INT, key);
+                int64_t x = v;
+                sb->sputn((const char *)&x, 8);
+            }
+
+            /// 无符号整数
+            template <typename T>
+            static typename std::enable_if<std::is_integral<T>::value && std::is_unsigned<T>::value && !std::is_same<T, bool>::value && !std::is_same<T, char>::value>::type
+            write(std::streambuf *sb, const char *key, T v)
+            {
+                writeKey(sb, LogFieldType::UINT, key);
+                uint64_t x = v;
+                sb->sputn((const char *)&x, 8);
+            }
+
+            /// 浮点数
+            template <typename T>
+            static typename std::enable_if<std::is_floating_point<T>::value>::type
+            write(std::streambuf *sb, const char *key, T v)
+            {
+                writeKey(sb, LogFieldType::DOUBLE, key);
+                double x = v;
+                sb->sputn((const char *)&x, 8);
+            }
+
+            /**
+             * @brief 写入类型与键
+             */
+            static void writeKey(std::streambuf *sb, LogFieldType type, const char *key)
+            {
+                size_t n = std::strlen(key);
+                if (n > 255)
+                    n = 255;
+                sb->sputc((char)type);
+                sb->sputc((char)(unsigned char)n);
+                sb->sputn(key, n);
+            }
+        };
+
+        /**
+         * @class cf::utils::LogFieldReader
+         * @brief 依次解码LogFieldWriter编码的字段.
+         */
+        class LogFieldReader
+        {
+        public:
+            /**
+             * @brief 构造函数
+             * 
+             * @param[in] data 编码后的字段
+             * @param[in] len 字节数
+             */
+            LogFieldReader(const char *data, size_t len) : _p(data), _end(data + len) {}
+
+            /**
+             * @brief 解码下一个字段
+             * 
+             * @param[out] field 解码结果
+             * @return true 成功
+             * @return false 已没有字段(或数据不完整)
+             */
+            bool next(LogField &field);
+
+            /**
+             * @brief 把字段以" key=value"的形式追加到文本中.
+             * @details 字符串值含空白或控制字符、'='、'"'或为空时加双引号，换行符等被转义
+             * 
+             * @param[out] out 目标字符串
+             * @param[in] data 编码后的字段
+             * @param[in] len 字节数
+             */
+            static void appendText(std::string &out, const char *data, size_t len);
+
+            /**
+             * @brief 把BOOL、整数或浮点数字段的值以文本形式追加到字符串中(字符串字段不做任何事)
+             * 
+             * @param[out] out 目标字符串
+             * @param[in] field 字段
+             */
+            static void appendScalar(std::string &out, const LogField &field);
+
+        private:
+            const char *_p;   ///< 当前位置
+            const char *_end; ///< 结束位置
+        };
+    };
+};
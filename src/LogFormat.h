@@ -0,0 +1,259 @@
+/**
+ * @file LogFormat.h
+ * @author Genleung Lan (genleung@hotmail.com)
+ * @brief 类型安全、编译期检查的"{}"风格格式化
+ * @version 0.1
+ * @date 2021-07-31
+ * 
+ * @copyright Copyright (c) 2021
+ * 
+ */
+
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+/**
+ * @brief 生成一个可被"<<"写入LogStream的格式化对象.
+ * @details 格式字符串必须是字符串字面量: 占位符个数在编译期计算，并与参数个数进行static_assert检查
+ */
+#define CFLOG_FORMAT(fmt, ...) cf::utils::LogFormat::make<cf::utils::LogFormat::countPlaceholders(fmt)>(fmt, ##__VA_ARGS__)
+
+namespace cf
+{
+    namespace utils
+    {
+        template <typename... Args>
+        class FormatArgs;
+
+        /**
+         * @class cf::utils::LogFormat
+         * @brief "{}"风格的格式化工具.
+         * @details 每个"{}"依次被一个参数替换，"{{"与"}}"分别输出"{"与"}".
+         * 参数直接写入目标流的缓冲区: 整数使用手写的数字转换，字符串直接拷贝，没有长度限制，也不产生中间std::string.
+         */
+        class LogFormat
+        {
+        public:
+            /**
+             * @brief 编译期计算格式字符串中的占位符个数.
+             * 
+             * @param[in] fmt 格式字符串
+             * @return int 占位符个数; 若存在不成对的'{'或'}'则返回-1
+             */
+            static constexpr int countPlaceholders(const char *fmt)
+            {
+                int n = 0;
+                for (size_t i = 0; fmt[i]; i++)
+                {
+                    if (fmt[i] == '{')
+                    {
+                        if (fmt[i + 1] != '{' && fmt[i + 1] != '}')
+                            return -1;
+                        if (fmt[i + 1] == '}')
+                            n++;
+                        i++;
+                    }
+                    else if (fmt[i] == '}')
+                    {
+                        if (fmt[i + 1] != '}')
+                            return -1;
+                        i++;
+                    }
+                }
+                return n;
+            }
+
+            /**
+             * @brief 生成格式化对象，并检查占位符个数与参数个数是否一致.
+             * 
+             * @tparam N 编译期计算出的占位符个数
+             * @param[in] fmt 格式字符串
+             * @param[in] args 参数列表
+             * @return FormatArgs<Args...> 格式化对象，仅引用参数，须在同一个表达式中被写入流
+             */
+            template <int N, typename... Args>
+            static FormatArgs<Args...> make(const char *fmt, const Args &...args)
+            {
+                static_assert(N >= 0, "cfLog: malformed format string (unmatched '{' or '}')");
+                static_assert(N == (int)sizeof...(Args), "cfLog: number of {} placeholders does not match the number of arguments");
+                return FormatArgs<Args...>(fmt, args...);
+            }
+
+            /**
+             * @brief 输出格式字符串中下一个占位符之前的文字，并把p移动到该占位符之后.
+             * 
+             * @param[in] sb 目标流缓冲区
+             * @param[in,out] p 格式字符串的当前位置
+             */
+            static void writeLiteral(std::streambuf *sb, const char *&p)
+            {
+                const char *start = p;
+                for (;;)
+                {
+                    char c = *p;
+                    if (c == '\0')
+                    {
+                        sb->sputn(start, p - start);
+                        return;
+                    }
+                    if (c == '{' && p[1] == '}')
+                    {
+                        sb->sputn(start, p - start);
+                        p += 2;
+                        return;
+                    }
+                    if ((c == '{' || c == '}') && p[1] == c)
+                    {
+                        // "{{"与"}}"只输出一个字符
+                        sb->sputn(start, p - start + 1);
+                        p += 2;
+                        start = p;
+                        continue;
+                    }
+                    p++;
+                }
+            }
+
+            static void writeValue(std::streambuf *sb, std::ostream &, const char *v)
+            {
+                if (v == nullptr)
+                    v = "(null)";
+                sb->sputn(v, std::strlen(v));
+            }
+
+            static void writeValue(std::streambuf *sb, std::ostream &, const std::string &v)
+            {
+                sb->sputn(v.data(), v.size());
+            }
+
+            static void writeValue(std::streambuf *sb, std::ostream &, bool v)
+            {
+                if (v)
+                    sb->sputn("true", 4);
+                else
+                    sb->sputn("false", 5);
+            }
+
+            static void writeValue(std::streambuf *sb, std::ostream &, char v)
+            {
+                sb->sputc(v);
+            }
+
+            /// 整数: 手写的数字转换
+            template <typename T>
+            static typename std::enable_if<std::is_integral<T>::value>::type
+            writeValue(std::streambuf *sb, std::ostream &, T v)
+            {
+                char buf[24];
+                char *end = buf + sizeof(buf);
+                char *p = end;
+                typedef typename std::make_unsigned<T>::type U;
+                U u = (U)v;
+                bool negative = std::is_signed<T>::value && v < (T)0;
+                if (negative)
+                    u = (U)(0 - u);
+                do
+                {
+                    *--p = (char)('0' + u % 10);
+                    u /= 10;
+                } while (u);
+                if (negative)
+                    *--p = '-';
+                sb->sputn(p, end - p);
+            }
+
+            /// 浮点数: 与"<<"的默认输出一致(6位有效数字)
+            template <typename T>
+            static typename std::enable_if<std::is_floating_point<T>::value>::type
+            writeValue(std::streambuf *sb, std::ostream &, T v)
+            {
+                char buf[32];
+                int n = std::snprintf(buf, sizeof(buf), "%g", (double)v);
+                sb->sputn(buf, n);
+            }
+
+            /// 其它类型: 交给operator<<
+            template <typename T>
+            static typename std::enable_if<!std::is_arithmetic<T>::value && !std::is_convertible<T, const char *>::value>::type
+            writeValue(std::streambuf *, std::ostream &os, const T &v)
+            {
+                os << v;
+            }
+        };
+
+        /**
+         * @class cf::utils::FormatArgs
+         * @brief 由LogFormat::make()生成的格式化对象，被"<<"写入流时才进行格式化.
+         * 
+         * @tparam Args 参数类型列表
+         */
+        template <typename... Args>
+        class FormatArgs
+        {
+        public:
+            FormatArgs(const char *fmt, const Args &...args) : _fmt(fmt), _args(args...) {}
+
+            /**
+             * @brief 把格式化结果写入流
+             * 
+             * @param[in] os 目标流
+             */
+            void writeTo(std::ostream &os) const
+            {
+                // 被过滤掉的LogStream处于bad状态，不做任何格式化
+                if (!os.good())
+                    return;
+                std::streambuf *sb = os.rdbuf();
+                const char *p = _fmt;
+                writeArgs(sb, os, p, std::index_sequence_for<Args...>());
+                LogFormat::writeLiteral(sb, p);
+            }
+
+            /**
+             * @brief 格式字符串
+             */
+            const char *format() const { return _fmt; }
+
+            /**
+             * @brief 参数(的引用)
+             */
+            const std::tuple<const Args &...> &values() const { return _args; }
+
+            /**
+             * @brief 以std::string形式返回格式化结果
+             */
+            std::string str() const
+            {
+                std::ostringstream os;
+                writeTo(os);
+                return os.str();
+            }
+
+            friend std::ostream &operator<<(std::ostream &os, const FormatArgs &f)
+            {
+                f.writeTo(os);
+                return os;
+            }
+
+        private:
+            template <size_t... I>
+            void writeArgs(std::streambuf *sb, std::ostream &os, const char *&p, std::index_sequence<I...>) const
+            {
+                int expand[] = {0, (LogFormat::writeLiteral(sb, p), LogFormat::writeValue(sb, os, std::get<I>(_args)), 0)...};
+                (void)expand;
+            }
+
+        private:
+            const char *_fmt;                    ///< 格式字符串
+            std::tuple<const Args &...> _args;   ///< 参数的引用
+        };
+    };
+};
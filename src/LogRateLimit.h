@@ -0,0 +1,103 @@
+/**
+ * @file LogRateLimit.h
+ * @author Genleung Lan (genleung@hotmail.com)
+ * @brief 按调用点的log限速
+ * @version 0.1
+ * @date 2021-07-31
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+
+namespace cf
+{
+    namespace utils
+    {
+        /**
+         * @class cf::utils::LogSiteLimiter
+         * @brief 一个log调用点的限速状态(令牌桶).
+         * @details 由LOGL/TRACEL等宏在每个调用点定义一个静态实例(常量初始化，无需加锁);
+         * 以GCRA算法实现令牌桶: 只保存"理论到达时间"一个原子变量，判断与更新为一次CAS，不加锁.
+         * 被限速丢弃的记录数累积在本对象中，在该调用点下一条被放行的记录上以suppressed=N字段报告;
+         * 此后一直没有记录被放行时，由Log::flush()或定期的运行统计取走并报告(见takeSuppressed())
+         */
+        class LogSiteLimiter
+        {
+        public:
+            /// 每秒条数取该值时，该调用点不限速(忽略Log的全局设定)
+            static const unsigned kUnlimited = UINT_MAX;
+
+            /**
+             * @brief 构造函数
+             *
+             * @param[in] perSecond 每秒放行的记录数;0表示使用Log的全局设定，kUnlimited表示不限速
+             * @param[in] burst 允许的突发记录数
+             */
+            constexpr LogSiteLimiter(unsigned perSecond = 0, unsigned burst = 0)
+                : _perSecond(perSecond), _burst(burst), _tat(0), _suppressed(0)
+            {
+            }
+
+            /**
+             * @brief 调用点自身设定的每秒条数(0表示使用全局设定)
+             */
+            unsigned perSecond() const { return _perSecond; }
+
+            /**
+             * @brief 调用点自身设定的突发条数
+             */
+            unsigned burst() const { return _burst; }
+
+            /**
+             * @brief 判断是否放行一条记录
+             *
+             * @param[in] perSecond 每秒放行的记录数(必须大于0)
+             * @param[in] burst 允许的突发记录数(至少为1)
+             * @param[out] suppressed 放行时返回此前被丢弃的记录数
+             * @return true 放行; false 丢弃
+             */
+            bool admit(unsigned perSecond, unsigned burst, uint64_t &suppressed)
+            {
+                using namespace std::chrono;
+                int64_t now = duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+                int64_t interval = 1000000000LL / perSecond;
+                int64_t tolerance = interval * (int64_t)(burst ? burst : 1);
+
+                int64_t tat = _tat.load(std::memory_order_relaxed);
+                for (;;)
+                {
+                    int64_t start = tat > now ? tat : now;
+                    if (start + interval - now > tolerance)
+                    {
+                        _suppressed.fetch_add(1, std::memory_order_relaxed);
+                        return false;
+                    }
+                    if (_tat.compare_exchange_weak(tat, start + interval, std::memory_order_relaxed))
+                        break;
+                }
+                suppressed = takeSuppressed();
+                return true;
+            }
+
+            /**
+             * @brief 取走尚未报告的被丢弃记录数(清零)
+             */
+            uint64_t takeSuppressed()
+            {
+                return _suppressed.load(std::memory_order_relaxed) ? _suppressed.exchange(0, std::memory_order_relaxed) : 0;
+            }
+
+        private:
+            const unsigned _perSecond;          ///< 每秒放行的记录数
+            const unsigned _burst;              ///< 允许的突发记录数
+            std::atomic<int64_t> _tat;          ///< 理论到达时间(纳秒)
+            std::atomic<uint64_t> _suppressed;  ///< 自上次放行后被丢弃的记录数
+        };
+    };
+};
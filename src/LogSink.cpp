@@ -0,0 +1,245 @@
+#include "LogSink.h"
+#include <climits>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <vector>
+
+namespace cf
+{
+    namespace utils
+    {
+        namespace
+        {
+            /// 被Log对象使用过的输出目标(弱引用)
+            struct SinkTracker
+            {
+                std::mutex mutex;
+                std::vector<std::weak_ptr<LogSink>> sinks;
+            };
+
+            SinkTracker &tracker()
+            {
+                static SinkTracker t;
+                return t;
+            }
+
+            void flushAtExit()
+            {
+                LogSink::flushAll();
+            }
+        }
+
+        void LogSink::track(const std::shared_ptr<LogSink> &sink)
+        {
+            SinkTracker &t = tracker();
+            static std::once_flag once;
+            // 在tracker构造之后注册，因而会在其析构之前被调用
+            std::call_once(once, []()
+                           { std::atexit(flushAtExit); });
+
+            std::lock_guard<std::mutex> lock(t.mutex);
+            for (auto it = t.sinks.begin(); it != t.sinks.end();)
+            {
+                std::shared_ptr<LogSink> p = it->lock();
+                if (!p)
+                {
+                    it = t.sinks.erase(it);
+                    continue;
+                }
+                if (p == sink)
+                    return;
+                ++it;
+            }
+            t.sinks.push_back(sink);
+        }
+
+        void LogSink::flushAll()
+        {
+            SinkTracker &t = tracker();
+            std::vector<std::shared_ptr<LogSink>> alive;
+            {
+                std::lock_guard<std::mutex> lock(t.mutex);
+                for (auto &w : t.sinks)
+                {
+                    std::shared_ptr<LogSink> p = w.lock();
+                    if (p)
+                        alive.push_back(p);
+                }
+            }
+            for (auto &p : alive)
+                p->flush();
+        }
+
+        void LogSink::writeRecord(const LogRecordView &rec)
+        {
+            if (rec.fieldsLength == 0)
+            {
+                write(rec.level, rec.text, rec.textLength);
+                return;
+            }
+
+            // 本线程的文本缓冲，容量跨记录重复使用
+            thread_local std::string line;
+            line.assign(rec.text, rec.textLength);
+            LogFieldReader::appendText(line, rec.fields, rec.fieldsLength);
+            write(rec.level, line.data(), line.size());
+        }
+
+        std::shared_ptr<ConsoleSink> ConsoleSink::instance()
+        {
+            static std::shared_ptr<ConsoleSink> sink = std::make_shared<ConsoleSink>();
+            return sink;
+        }
+
+        void ConsoleSink::write(LogLevel, const char *data, size_t len)
+        {
+            std::unique_lock<std::mutex> lock = lockForWrite();
+            std::cout.write(data, len).put('\n');
+        }
+
+        void ConsoleSink::writeBytes(LogLevel, const char *data, size_t len)
+        {
+            std::unique_lock<std::mutex> lock = lockForWrite();
+            std::cout.write(data, len);
+        }
+
+        void ConsoleSink::flush()
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            std::cout.flush();
+        }
+
+        std::string FileSink::canonicalPath(const std::string &file)
+        {
+#if defined(_WIN32) || defined(_WIN64)
+            char buf[_MAX_PATH];
+            if (_fullpath(buf, file.c_str(), sizeof(buf)))
+                return buf;
+            return file;
+#else
+            char buf[PATH_MAX];
+            if (realpath(file.c_str(), buf))
+                return buf;
+
+            // 文件尚不存在: 规范化其所在目录，再拼上文件名
+            size_t pos = file.find_last_of('/');
+            std::string dir = (pos == std::string::npos) ? "." : (pos == 0 ? "/" : file.substr(0, pos));
+            std::string name = (pos == std::string::npos) ? file : file.substr(pos + 1);
+            if (realpath(dir.c_str(), buf))
+            {
+                std::string path(buf);
+                if (path.back() != '/')
+                    path += '/';
+                return path + name;
+            }
+            return file;
+#endif
+        }
+
+        std::shared_ptr<FileSink> FileSink::open(const std::string &file, bool append)
+        {
+            static std::mutex registryMutex;
+            static std::map<std::string, std::weak_ptr<FileSink>> registry;
+
+            std::string path = canonicalPath(file);
+
+            std::lock_guard<std::mutex> lock(registryMutex);
+            auto it = registry.find(path);
+            if (it != registry.end())
+            {
+                std::shared_ptr<FileSink> sink = it->second.lock();
+                if (sink)
+                    return sink;
+            }
+
+            std::shared_ptr<FileSink> sink(new FileSink(path, append));
+            if (!sink->_ofs.is_open())
+                return nullptr;
+
+            // 顺便清理已关闭的文件
+            for (auto i = registry.begin(); i != registry.end();)
+            {
+                if (i->second.expired())
+                    i = registry.erase(i);
+                else
+                    ++i;
+            }
+            registry[path] = sink;
+            return sink;
+        }
+
+        FileSink::FileSink(const std::string &path, bool append) : _path(path)
+        {
+            if (append)
+                _ofs.open(path, std::ios::out | std::ios::app);
+            else
+                _ofs.open(path, std::ios::out);
+        }
+
+        FileSink::~FileSink()
+        {
+            if (_ofs.is_open())
+            {
+                _ofs.flush();
+                _ofs.close();
+            }
+        }
+
+        void FileSink::write(LogLevel, const char *data, size_t len)
+        {
+            std::unique_lock<std::mutex> lock = lockForWrite();
+            _ofs.write(data, len).put('\n');
+        }
+
+        void FileSink::writeBytes(LogLevel, const char *data, size_t len)
+        {
+            std::unique_lock<std::mutex> lock = lockForWrite();
+            _ofs.write(data, len);
+        }
+
+        void FileSink::flush()
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _ofs.flush();
+        }
+
+        MemorySink::MemorySink(size_t maxRecords) : _ring(maxRecords ? maxRecords : 1)
+        {
+        }
+
+        void MemorySink::write(LogLevel, const char *data, size_t len)
+        {
+            std::lock_guard<std::mutex> lock(_ringMutex);
+            _ring[_next].assign(data, len);
+            _next = (_next + 1) % _ring.size();
+            if (_count < _ring.size())
+                ++_count;
+        }
+
+        std::vector<std::string> MemorySink::records() const
+        {
+            std::lock_guard<std::mutex> lock(_ringMutex);
+            std::vector<std::string> result;
+            result.reserve(_count);
+            size_t first = (_next + _ring.size() - _count) % _ring.size();
+            for (size_t i = 0; i < _count; i++)
+                result.push_back(_ring[(first + i) % _ring.size()]);
+            return result;
+        }
+
+        void MemorySink::clear()
+        {
+            std::lock_guard<std::mutex> lock(_ringMutex);
+            _next = 0;
+            _count = 0;
+        }
+
+        void CallbackSink::write(LogLevel level, const char *data, size_t len)
+        {
+            std::unique_lock<std::mutex> lock = lockForWrite();
+            if (_callback)
+                _callback(level, data, len);
+        }
+    };
+};
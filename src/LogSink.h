@@ -0,0 +1,264 @@
+/**
+ * @file LogSink.h
+ * @author Genleung Lan (genleung@hotmail.com)
+ * @brief log输出目标
+ * @version 0.1
+ * @date 2021-07-31
+ * 
+ * @copyright Copyright (c) 2021
+ * 
+ */
+
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "LogFields.h"
+
+namespace cf
+{
+    namespace utils
+    {
+        enum class LogLevel;
+
+        /**
+         * @class cf::utils::LogSink
+         * @brief log输出目标的基类.
+         * @details 每个输出目标自带一把互斥量，只有写同一个目标的Log对象之间才会相互竞争;
+         * 写不同目标的Log对象互不干扰.
+         */
+        class LogSink
+        {
+        public:
+            virtual ~LogSink() {}
+
+            /**
+             * @brief 写入一条完整的log记录(由本函数追加换行符)
+             * @details 同一目标上的多条记录不会相互交错
+             * 
+             * @param[in] level log等级
+             * @param[in] data log信息
+             * @param[in] len log信息的字节数
+             */
+            virtual void write(LogLevel level, const char *data, size_t len) = 0;
+
+            /**
+             * @brief 原样写入一段自行分帧的字节(不追加换行符)，见LogFormatter::binary().
+             * @details 默认实现调用write(): 逐条保存记录的目标(如MemorySink、CallbackSink)无需重写;
+             * 以字节流写入文件或控制台的目标重写之
+             * 
+             * @param[in] level log等级
+             * @param[in] data 数据
+             * @param[in] len 字节数
+             */
+            virtual void writeBytes(LogLevel level, const char *data, size_t len) { write(level, data, len); }
+
+            /**
+             * @brief 写入一条可能带有键值字段的log记录.
+             * @details Log通过本函数写入;默认实现把字段以" key=value"的形式追加在文本之后再调用write(),
+             * 需要按结构输出的目标(如MultiSink)可重写之
+             * 
+             * @param[in] rec log记录
+             */
+            virtual void writeRecord(const LogRecordView &rec);
+
+            /**
+             * @brief 是否必须在产生记录的线程上写入(如按线程保存记录的FlightRecorderSink).
+             * @details 这样的目标由Log在调用线程上通过capture()写入(异步/暂存模式下在记录入队之前)，
+             * 后台写线程不再把记录写给它们
+             */
+            virtual bool perThread() const { return false; }
+
+            /**
+             * @brief 在产生记录的线程上接收一条记录(由Log对每条记录调用).
+             * @details 默认实现: perThread()为true时调用writeRecord()，否则什么也不做;MultiSink把记录转给其中的此类目标
+             * 
+             * @param[in] rec log记录
+             */
+            virtual void capture(const LogRecordView &rec)
+            {
+                if (perThread())
+                    writeRecord(rec);
+            }
+
+            /**
+             * @brief 刷新输出缓冲
+             */
+            virtual void flush() {}
+
+            /**
+             * @brief 登记一个正在被Log对象使用的输出目标，使其在进程退出(或FATAL)时能被flushAll()刷新
+             * @details 由Log::setLogSink()调用;仅保存弱引用，不延长输出目标的生命期
+             * 
+             * @param[in] sink 输出目标
+             */
+            static void track(const std::shared_ptr<LogSink> &sink);
+
+            /**
+             * @brief 刷新所有登记过且仍然存活的输出目标.
+             * @details 首次调用track()时会通过std::atexit()注册本函数，保证进程正常退出时缓冲中的记录被写出
+             */
+            static void flushAll();
+
+            /**
+             * @brief 写入时在本输出目标的互斥量上等待的总时间(纳秒).
+             * @details 输出目标可能被多个Log对象共享，因此这是所有使用者的合计
+             */
+            virtual uint64_t lockWaitNanos() const { return _lockWaitNs.load(std::memory_order_relaxed); }
+
+            /**
+             * @brief 本输出目标自身丢弃的记录数(如磁盘已满、缓冲区已满)，不丢弃记录的输出目标返回0
+             */
+            virtual uint64_t droppedCount() const { return 0; }
+
+        protected:
+            /**
+             * @brief 获取_mutex，需要等待时把等待的时间计入lockWaitNanos().
+             * @details 锁空闲时只多一次try_lock，不读取时钟
+             */
+            std::unique_lock<std::mutex> lockForWrite()
+            {
+                std::unique_lock<std::mutex> lock(_mutex, std::try_to_lock);
+                if (!lock.owns_lock())
+                {
+                    auto start = std::chrono::steady_clock::now();
+                    lock.lock();
+                    auto waited = std::chrono::steady_clock::now() - start;
+                    _lockWaitNs.fetch_add((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(waited).count(), std::memory_order_relaxed);
+                }
+                return lock;
+            }
+
+        protected:
+            std::mutex _mutex; ///< 保护本输出目标的互斥量
+            std::atomic<uint64_t> _lockWaitNs{0}; ///< 在_mutex上等待的总时间(纳秒)
+        };
+
+        /**
+         * @class cf::utils::ConsoleSink
+         * @brief 输出到std::cout.
+         * @details 进程内只有一个实例，所有输出到std::cout的Log对象共用其互斥量
+         */
+        class ConsoleSink : public LogSink
+        {
+        public:
+            /**
+             * @brief 获取全局唯一的ConsoleSink.
+             */
+            static std::shared_ptr<ConsoleSink> instance();
+
+            void write(LogLevel level, const char *data, size_t len) override;
+            void writeBytes(LogLevel level, const char *data, size_t len) override;
+            void flush() override;
+        };
+
+        /**
+         * @class cf::utils::FileSink
+         * @brief 输出到普通文件.
+         * @details 通过open()获得的FileSink按文件的规范化路径登记:
+         * 多个Log对象打开同一个文件时共享同一个FileSink(及其互斥量)，从而保证记录不会相互交错
+         */
+        class FileSink : public LogSink
+        {
+        public:
+            /**
+             * @brief 打开(或获取已打开的)log文件.
+             * @attention 若该文件已被其它Log对象打开，则直接共享之，append参数被忽略(不会截断他人正在写的文件)
+             * 
+             * @param[in] file log文件
+             * @param[in] append 是否以追加模式写入
+             * @return std::shared_ptr<FileSink> 打开失败时返回空指针
+             */
+            static std::shared_ptr<FileSink> open(const std::string &file, bool append);
+
+            /**
+             * @brief 把文件路径规范化(绝对路径、解析符号链接)，用作登记的键
+             * 
+             * @param[in] file 文件路径
+             * @return std::string 规范化后的路径
+             */
+            static std::string canonicalPath(const std::string &file);
+
+            ~FileSink();
+
+            void write(LogLevel level, const char *data, size_t len) override;
+            void writeBytes(LogLevel level, const char *data, size_t len) override;
+            void flush() override;
+
+            /**
+             * @brief 规范化后的文件路径
+             */
+            const std::string &path() const { return _path; }
+
+        private:
+            FileSink(const std::string &path, bool append);
+
+        private:
+            std::string _path;  ///< 规范化后的文件路径
+            std::ofstream _ofs; ///< 文件对象
+        };
+
+        /**
+         * @class cf::utils::MemorySink
+         * @brief 在内存中保留最近的N条记录.
+         * @details 记录存放在环形数组中，写满后覆盖最旧的记录;各槽位的字符串容量会被重复使用
+         */
+        class MemorySink : public LogSink
+        {
+        public:
+            /**
+             * @brief 构造函数
+             * 
+             * @param[in] maxRecords 最多保留的记录条数
+             */
+            explicit MemorySink(size_t maxRecords = 1024);
+
+            void write(LogLevel level, const char *data, size_t len) override;
+
+            /**
+             * @brief 获取当前保留的记录(由旧到新，不含换行符)
+             */
+            std::vector<std::string> records() const;
+
+            /**
+             * @brief 清空保留的记录
+             */
+            void clear();
+
+        private:
+            mutable std::mutex _ringMutex;    ///< 保护环形数组(records()为const函数，不能使用基类的_mutex)
+            std::vector<std::string> _ring;   ///< 环形数组
+            size_t _next = 0;                 ///< 下一条记录写入的位置
+            size_t _count = 0;                ///< 当前保留的记录条数
+        };
+
+        /**
+         * @class cf::utils::CallbackSink
+         * @brief 把每条记录交给用户的回调函数.
+         * @details 回调在本目标的互斥量内被调用，因此各次调用不会并发;回调中不应再调用写入本目标的log
+         */
+        class CallbackSink : public LogSink
+        {
+        public:
+            /// 回调函数: 参数为log等级、记录(不含换行符)及其字节数
+            using Callback = std::function<void(LogLevel, const char *, size_t)>;
+
+            /**
+             * @brief 构造函数
+             * 
+             * @param[in] callback 回调函数
+             */
+            explicit CallbackSink(Callback callback) : _callback(std::move(callback)) {}
+
+            void write(LogLevel level, const char *data, size_t len) override;
+
+        private:
+            Callback _callback; ///< 回调函数
+        };
+    };
+};
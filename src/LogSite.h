@@ -0,0 +1,102 @@
+/**
+ * @file LogSite.h
+ * @author Genleung Lan (genleung@hotmail.com)
+ * @brief 编译期生成的log调用点信息
+ * @version 0.1
+ * @date 2021-07-31
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include "LogRateLimit.h"
+
+/**
+ * @brief 编译期最低log等级: 低于该等级的LOG*与TRACE*语句在编译时即被去除(参数不会被求值).
+ * @details 取值与cf::utils::LogLevel一致: 0(INFO)、1(NOTICE)、2(WARN)、3(ERROR)、4(FATAL)
+ */
+#ifndef CFLOG_MIN_LEVEL
+#define CFLOG_MIN_LEVEL 0
+#endif
+
+namespace cf
+{
+    namespace utils
+    {
+        enum class LogLevel : int;
+
+        /**
+         * @class cf::utils::LogSite
+         * @brief 一个log调用点的信息.
+         * @details 由LOG*与TRACE*宏在每个调用点定义一个静态实例: 构造函数为constexpr，
+         * TAG、文件名(及其不含路径的部分)、行号、等级字符串及各字符串的长度都在编译期算好，
+         * 运行时只需传递一个指针，不再构造std::string、也不再查找路径分隔符.
+         * 同时保存该调用点的限速状态
+         */
+        struct LogSite
+        {
+            /**
+             * @brief 构造函数
+             *
+             * @param[in] curLevel log等级
+             * @param[in] tagString TAG(字符串字面量)
+             * @param[in] srcFile 源文件(__FILE__)，为空字符串时不记录位置
+             * @param[in] srcLine 行号
+             * @param[in] perSecond 该调用点的限速，见LogSiteLimiter
+             * @param[in] burst 该调用点允许的突发记录数
+             */
+            constexpr LogSite(LogLevel curLevel, const char *tagString, const char *srcFile, int srcLine, unsigned perSecond = 0, unsigned burst = 0)
+                : level(curLevel), levelString(levelPrefix(curLevel)), tag(tagString), tagLength(length(tagString)),
+                  path(srcFile), pathLength(length(srcFile)), file(basename(srcFile)), fileLength(length(basename(srcFile))),
+                  line(srcLine), limiter(perSecond, burst), nextLimited(nullptr), listed(false)
+            {
+            }
+
+            const LogLevel level;       ///< log等级
+            const char *levelString;    ///< 等级字符串，如"[I]"
+            const char *tag;            ///< TAG
+            const size_t tagLength;     ///< TAG的长度
+            const char *path;           ///< 源文件的完整路径
+            const size_t pathLength;    ///< 完整路径的长度
+            const char *file;           ///< 源文件名(不含路径)
+            const size_t fileLength;    ///< 源文件名的长度
+            const int line;             ///< 行号
+            LogSiteLimiter limiter;     ///< 限速状态
+            LogSite *nextLimited;       ///< 曾有记录被限速丢弃的调用点组成的链表，见Log::reportSuppressed()
+            std::atomic<bool> listed;   ///< 是否已加入上述链表
+
+            /// 编译期计算字符串长度
+            static constexpr size_t length(const char *s)
+            {
+                size_t n = 0;
+                while (s[n])
+                    n++;
+                return n;
+            }
+
+            /// 编译期去掉路径中的目录部分
+            static constexpr const char *basename(const char *path)
+            {
+                const char *name = path;
+                for (const char *p = path; *p; p++)
+                {
+                    if (*p == '/' || *p == '\\')
+                        name = p + 1;
+                }
+                return name;
+            }
+
+            /// 等级字符串
+            static constexpr const char *levelPrefix(LogLevel level)
+            {
+                return (int)level == 0 ? "[I]" : (int)level == 1 ? "[N]"
+                                             : (int)level == 2   ? "[W]"
+                                             : (int)level == 3   ? "[E]"
+                                                                 : "[F]";
+            }
+        };
+    };
+};
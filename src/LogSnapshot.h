@@ -0,0 +1,142 @@
+/**
+ * @file LogSnapshot.h
+ * @author Genleung Lan (genleung@hotmail.com)
+ * @brief 以RCU方式发布的只读快照
+ * @version 0.1
+ * @date 2021-07-31
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace cf
+{
+    namespace utils
+    {
+        /**
+         * @class cf::utils::LogSnapshot
+         * @brief 以RCU(读-拷贝-更新)方式发布的只读快照.
+         * @details 读者通过Reader进入读区，读取当前快照的指针，读区内该快照不会被释放;读者之间、读者与写者之间都不加锁.
+         * 写者拷贝当前快照、修改副本、以一次原子交换发布之，再等待仍可能引用旧快照的读者离开读区后把旧快照交还调用者;
+         * 写者之间以互斥量串行化，不会阻塞读者。
+         * 读区计数按线程分散在kStripes组中，并分奇偶两代: 写者每等待一代前先切换代，新进入的读者计入另一代，
+         * 因而在读者源源不断时写者也能等到旧的一代清空
+         */
+        template <typename T>
+        class LogSnapshot
+        {
+        public:
+            /// 读区计数的组数
+            static const size_t kStripes = 8;
+
+            /**
+             * @class cf::utils::LogSnapshot::Reader
+             * @brief 读区(RAII): 构造时进入，析构时离开.
+             * @attention 读区内不能在同一个LogSnapshot上调用update()，否则会死锁
+             */
+            class Reader
+            {
+            public:
+                explicit Reader(const LogSnapshot &snapshot)
+                {
+                    size_t stripe = stripeIndex();
+                    unsigned epoch = snapshot._epoch.load() & 1;
+                    _count = &snapshot._readers[epoch][stripe].count;
+                    // 先计数再读取指针(均为seq_cst): 写者要么看到本读者的计数，要么本读者读到的已是新快照
+                    _count->fetch_add(1);
+                    _value = snapshot._current.load();
+                }
+
+                ~Reader() { _count->fetch_sub(1, std::memory_order_release); }
+
+                Reader(const Reader &) = delete;
+                Reader &operator=(const Reader &) = delete;
+
+                const T *operator->() const { return _value; }
+                const T &operator*() const { return *_value; }
+
+            private:
+                std::atomic<long> *_count; ///< 本读者所在的读区计数
+                const T *_value;           ///< 读区内使用的快照
+            };
+
+            /**
+             * @brief 构造函数，初始快照为默认构造的T
+             */
+            LogSnapshot() : _current(new T()) {}
+
+            /**
+             * @brief 构造函数
+             *
+             * @param[in] initial 初始快照(由本对象接管)
+             */
+            explicit LogSnapshot(T *initial) : _current(initial) {}
+
+            ~LogSnapshot() { delete _current.load(); }
+
+            LogSnapshot(const LogSnapshot &) = delete;
+            LogSnapshot &operator=(const LogSnapshot &) = delete;
+
+            /**
+             * @brief 以当前快照的副本为基础修改并发布新快照.
+             * @details 返回时已没有读者引用旧快照
+             *
+             * @param[in] modify 修改副本的函数，形如void(T &)
+             * @return std::unique_ptr<T> 旧快照，由调用者在适当的时候(如刷新其中的输出目标之后)释放
+             */
+            template <typename F>
+            std::unique_ptr<T> update(F modify)
+            {
+                std::lock_guard<std::mutex> lock(_writeMutex);
+                std::unique_ptr<T> next(new T(*_current.load()));
+                modify(*next);
+                std::unique_ptr<T> old(_current.exchange(next.release()));
+                synchronize();
+                return old;
+            }
+
+        private:
+            /// 等待在此之前进入读区的读者全部离开
+            void synchronize()
+            {
+                for (int i = 0; i < 2; i++)
+                {
+                    unsigned epoch = _epoch.fetch_add(1) & 1;
+                    for (auto &r : _readers[epoch])
+                    {
+                        while (r.count.load(std::memory_order_acquire) != 0)
+                            std::this_thread::yield();
+                    }
+                }
+            }
+
+            /// 调用线程使用的读区计数组(线程按首次使用的顺序轮流分配到各组)
+            static size_t stripeIndex()
+            {
+                static std::atomic<size_t> next{0};
+                thread_local size_t index = next.fetch_add(1, std::memory_order_relaxed) % kStripes;
+                return index;
+            }
+
+            /// 一组读区计数，与相邻的组隔开，避免伪共享
+            struct Counter
+            {
+                std::atomic<long> count{0};
+                char padding[64 - sizeof(std::atomic<long>)];
+            };
+
+        private:
+            std::atomic<T *> _current;                   ///< 当前快照
+            std::atomic<unsigned> _epoch{0};             ///< 读区计数的代，读者计入_readers[_epoch & 1]
+            mutable Counter _readers[2][kStripes];       ///< 两代的读区计数
+            std::mutex _writeMutex;                      ///< 串行化写者
+        };
+    };
+};
@@ -0,0 +1,60 @@
+#include "LogStats.h"
+
+namespace cf
+{
+    namespace utils
+    {
+        uint64_t LogHistogram::percentile(double p) const
+        {
+            if (count == 0)
+                return 0;
+
+            uint64_t rank = (uint64_t)(p * count + 0.5);
+            if (rank == 0)
+                rank = 1;
+            uint64_t seen = 0;
+            for (size_t i = 0; i < kBuckets; i++)
+            {
+                seen += buckets[i];
+                if (seen >= rank)
+                {
+                    // 最后一个桶没有上界
+                    if (i == kBuckets - 1)
+                        return maxNs;
+                    uint64_t upper = i == 0 ? 0 : ((uint64_t)1 << i) - 1;
+                    return upper < maxNs ? upper : maxNs;
+                }
+            }
+            return maxNs;
+        }
+
+        void LogStatsCounters::snapshot(LogStats &stats) const
+        {
+            stats = LogStats();
+            auto addHistogram = [](LogHistogram &h, const Histogram &src)
+            {
+                for (size_t i = 0; i < LogHistogram::kBuckets; i++)
+                    h.buckets[i] += src.buckets[i].load(std::memory_order_relaxed);
+                h.count += src.count.load(std::memory_order_relaxed);
+                h.sumNs += src.sum.load(std::memory_order_relaxed);
+                uint64_t m = src.max.load(std::memory_order_relaxed);
+                if (m > h.maxNs)
+                    h.maxNs = m;
+            };
+
+            for (const Stripe &s : _stripes)
+            {
+                for (int i = 0; i < LogStats::kLevels; i++)
+                {
+                    stats.emitted[i] += s.emitted[i].load(std::memory_order_relaxed);
+                    stats.filtered[i] += s.filtered[i].load(std::memory_order_relaxed);
+                    stats.dropped[i] += s.dropped[i].load(std::memory_order_relaxed);
+                }
+                stats.bytesWritten += s.bytes.load(std::memory_order_relaxed);
+                stats.flushes += s.flushes.load(std::memory_order_relaxed);
+                addHistogram(stats.enqueueLatency, s.enqueue);
+                addHistogram(stats.writeLatency, s.write);
+            }
+        }
+    };
+};
@@ -0,0 +1,168 @@
+/**
+ * @file LogStats.h
+ * @author Genleung Lan (genleung@hotmail.com)
+ * @brief Log自身的运行统计: 计数器与延迟直方图
+ * @version 0.1
+ * @date 2021-07-31
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace cf
+{
+    namespace utils
+    {
+        enum class LogLevel : int;
+
+        /**
+         * @class cf::utils::LogHistogram
+         * @brief 延迟直方图(快照).
+         * @details 按2的幂分桶: buckets[0]对应0纳秒，buckets[i]对应[2^(i-1), 2^i)纳秒
+         */
+        struct LogHistogram
+        {
+            /// 桶的个数，最后一个桶容纳所有更大的值
+            static const size_t kBuckets = 40;
+
+            uint64_t buckets[kBuckets] = {}; ///< 各桶的样本数
+            uint64_t count = 0;              ///< 样本总数
+            uint64_t sumNs = 0;              ///< 样本之和(纳秒)
+            uint64_t maxNs = 0;              ///< 最大值(纳秒)
+
+            /**
+             * @brief 估算分位数
+             *
+             * @param[in] p 分位(0~1)，如0.99
+             * @return uint64_t 分位数所在桶的上界(纳秒)，不超过maxNs;无样本时为0
+             */
+            uint64_t percentile(double p) const;
+
+            /**
+             * @brief 平均值(纳秒)
+             */
+            double mean() const { return count ? (double)sumNs / count : 0; }
+
+            /**
+             * @brief 一个值所在的桶
+             */
+            static size_t bucketOf(uint64_t ns)
+            {
+                size_t b = 0;
+                while (ns && b < kBuckets - 1)
+                {
+                    ns >>= 1;
+                    b++;
+                }
+                return b;
+            }
+        };
+
+        /**
+         * @class cf::utils::LogStats
+         * @brief Log对象的运行统计快照，由Log::stats()返回.
+         * @details 所有数值均为Log对象创建以来的累计值;各计数器分别读取，彼此之间不保证严格一致
+         */
+        struct LogStats
+        {
+            /// log等级的个数
+            static const int kLevels = 5;
+
+            uint64_t emitted[kLevels] = {};  ///< 提交输出的记录数(按等级;其中因异步队列溢出而被丢弃的也计入dropped)
+            uint64_t filtered[kLevels] = {}; ///< 低于等级阈值而被过滤的记录数(按等级);需Log::enableFilteredStats()
+            uint64_t dropped[kLevels] = {};  ///< 被限速或因异步队列溢出而被丢弃的记录数(按等级)
+            uint64_t bytesWritten = 0;       ///< 写入输出目标的字节数(含字段，不含换行符)
+            uint64_t flushes = 0;            ///< 刷新输出目标的次数
+            uint64_t lockWaitNs = 0;         ///< 在当前输出目标的互斥量上等待的总时间(纳秒)，见LogSink::lockWaitNanos()
+            uint64_t sinkDropped = 0;        ///< 当前输出目标自身丢弃的记录数(如磁盘已满)，见LogSink::droppedCount()
+            LogHistogram enqueueLatency;     ///< 提交一条记录的耗时(同步模式下包含写入);需Log::enableLatencyStats()
+            LogHistogram writeLatency;       ///< 把一条记录写入输出目标的耗时(含刷新);需Log::enableLatencyStats()
+
+            /**
+             * @brief 各等级之和
+             */
+            static uint64_t total(const uint64_t (&counts)[kLevels])
+            {
+                uint64_t n = 0;
+                for (int i = 0; i < kLevels; i++)
+                    n += counts[i];
+                return n;
+            }
+        };
+
+        /**
+         * @class cf::utils::LogStatsCounters
+         * @brief Log内部使用的统计计数器.
+         * @details 计数器按线程分散到kStripes组中，每个线程固定使用其中一组，只做relaxed原子加，不加锁;
+         * 组与组之间相互隔开，多个线程同时log时不会争用同一条缓存行。读取时把各组相加
+         */
+        class LogStatsCounters
+        {
+        public:
+            /// 计数器的组数
+            static const size_t kStripes = 8;
+
+            void emitted(LogLevel level) { local().emitted[(int)level].fetch_add(1, std::memory_order_relaxed); }
+            void filtered(LogLevel level) { local().filtered[(int)level].fetch_add(1, std::memory_order_relaxed); }
+            void dropped(LogLevel level) { local().dropped[(int)level].fetch_add(1, std::memory_order_relaxed); }
+            void written(size_t bytes) { local().bytes.fetch_add(bytes, std::memory_order_relaxed); }
+            void flushed() { local().flushes.fetch_add(1, std::memory_order_relaxed); }
+            void enqueueLatency(uint64_t ns) { local().enqueue.add(ns); }
+            void writeLatency(uint64_t ns) { local().write.add(ns); }
+
+            /**
+             * @brief 把各组计数器相加，填入快照(不含lockWaitNs与sinkDropped)
+             *
+             * @param[out] stats 快照
+             */
+            void snapshot(LogStats &stats) const;
+
+        private:
+            struct Histogram
+            {
+                std::atomic<uint64_t> buckets[LogHistogram::kBuckets] = {};
+                std::atomic<uint64_t> count{0};
+                std::atomic<uint64_t> sum{0};
+                std::atomic<uint64_t> max{0};
+
+                void add(uint64_t ns)
+                {
+                    buckets[LogHistogram::bucketOf(ns)].fetch_add(1, std::memory_order_relaxed);
+                    count.fetch_add(1, std::memory_order_relaxed);
+                    sum.fetch_add(ns, std::memory_order_relaxed);
+                    uint64_t m = max.load(std::memory_order_relaxed);
+                    while (ns > m && !max.compare_exchange_weak(m, ns, std::memory_order_relaxed))
+                        ;
+                }
+            };
+
+            struct Stripe
+            {
+                std::atomic<uint64_t> emitted[LogStats::kLevels] = {};
+                std::atomic<uint64_t> filtered[LogStats::kLevels] = {};
+                std::atomic<uint64_t> dropped[LogStats::kLevels] = {};
+                std::atomic<uint64_t> bytes{0};
+                std::atomic<uint64_t> flushes{0};
+                Histogram enqueue;
+                Histogram write;
+                char padding[64]; ///< 与下一组隔开，避免伪共享
+            };
+
+            /// 调用线程使用的一组计数器(线程按首次使用的顺序轮流分配到各组)
+            Stripe &local()
+            {
+                static std::atomic<size_t> next{0};
+                thread_local size_t index = next.fetch_add(1, std::memory_order_relaxed) % kStripes;
+                return _stripes[index];
+            }
+
+        private:
+            Stripe _stripes[kStripes];
+        };
+    };
+};
@@ -1,16 +1,139 @@
+
 #include "LogStream.h"
 #include "Log.h"
+#include <cstdio>
+#include <cstring>
 
 namespace cf {
     namespace utils {
-        LogStream::LogStream(Log* p, LogLevel l, std::string pre)
-            : _pLog(p), _curLevel(l), _prefix(pre) {
-            (*this) << _prefix;
+        namespace {
+            /// 线程局部的缓冲池，保存空闲的缓冲区
+            struct LogBufferPool {
+                static const int kMaxFree = 8;
+                char* free[kMaxFree];
+                int count = 0;
+
+                char* acquire() {
+                    if (count > 0)
+                        return free[--count];
+                    return new char[LogStreamBuf::kBufferSize];
+                }
+
+                void release(char* buf) {
+                    if (count < kMaxFree)
+                        free[count++] = buf;
+                    else
+                        delete[] buf;
+                }
+
+                ~LogBufferPool() {
+                    while (count > 0)
+                        delete[] free[--count];
+                }
+            };
+
+            thread_local LogBufferPool bufferPool;
+        }
+
+        LogStreamBuf::LogStreamBuf()
+            : _pooled(bufferPool.acquire()) {
+            setp(_pooled, _pooled + kBufferSize);
+        }
+
+        LogStreamBuf::LogStreamBuf(LogStreamBuf&& other)
+            : _pooled(other._pooled), _heap(std::move(other._heap)) {
+            setp(other.pbase(), other.epptr());
+            pbump((int)other.size());
+            other._pooled = nullptr;
+            other.setp(nullptr, nullptr);
+        }
+
+        LogStreamBuf::~LogStreamBuf() {
+            if (_pooled)
+                bufferPool.release(_pooled);
+        }
+
+        void LogStreamBuf::grow(size_t need) {
+            size_t used = size();
+            size_t cap = (epptr() - pbase()) * 2;
+            if (cap == 0)
+                cap = kBufferSize; // 已被移走的缓冲区
+            while (cap < used + need)
+                cap *= 2;
+
+            std::unique_ptr<char[]> buf(new char[cap]);
+            std::memcpy(buf.get(), pbase(), used);
+            _heap.swap(buf);
+            if (_pooled) {
+                bufferPool.release(_pooled);
+                _pooled = nullptr;
+            }
+            setp(_heap.get(), _heap.get() + cap);
+            pbump((int)used);
+        }
+
+        LogStreamBuf::int_type LogStreamBuf::overflow(int_type ch) {
+            if (traits_type::eq_int_type(ch, traits_type::eof()))
+                return traits_type::not_eof(ch);
+            grow(1);
+            *pptr() = traits_type::to_char_type(ch);
+            pbump(1);
+            return ch;
+        }
+
+        std::streamsize LogStreamBuf::xsputn(const char* s, std::streamsize n) {
+            if (epptr() - pptr() < n)
+                grow((size_t)n);
+            std::memcpy(pptr(), s, (size_t)n);
+            pbump((int)n);
+            return n;
+        }
+
+        void LogStreamBuf::vprintf(const char* format, va_list args) {
+            va_list args2;
+            va_copy(args2, args);
+            size_t room = epptr() - pptr();
+            int n = vsnprintf(pptr(), room, format, args);
+            if (n >= 0 && (size_t)n >= room) {
+                // 剩余空间不足: 按实际长度扩充后重新格式化
+                grow((size_t)n + 1);
+                vsnprintf(pptr(), (size_t)n + 1, format, args2);
+            }
+            va_end(args2);
+            if (n > 0)
+                pbump(n);
+        }
+
+        LogStream::LogStream(Log* p, LogLevel l)
+            : std::ostream(nullptr), _curLevel(l), _pLog(p) {
+            if (_pLog == nullptr) {
+                // 无输出目标时置为bad状态，后续的"<<"操作均不再进行格式化
+                setstate(std::ios::badbit);
+                return;
+            }
+            rdbuf(&_buf);
+        }
+
+        LogStream::LogStream(LogStream&& ls)
+            : std::ostream(nullptr), _curLevel(ls._curLevel), _pLog(ls._pLog),
+              _buf(std::move(ls._buf)), _fields(std::move(ls._fields)), _layout(ls._layout) {
+            ls._pLog = nullptr;
+            ls.setstate(std::ios::badbit);
+            if (_pLog == nullptr) {
+                setstate(std::ios::badbit);
+                return;
+            }
+            rdbuf(&_buf);
         }
 
-        LogStream::LogStream(const LogStream& ls)
-            : _pLog(ls._pLog), _curLevel(ls._curLevel), _prefix(ls._prefix) {
-            (*this) << _prefix;
+        LogStream& LogStream::printf(const char* format, ...) {
+            if (_pLog == nullptr)
+                return *this;
+            va_list args;
+            va_start(args, format);
+            _buf.vprintf(format, args);
+            va_end(args);
+            return *this;
         }
 
         LogStream::~LogStream() {
@@ -10,19 +10,86 @@
  */
 
 #pragma once
+#include <cstdarg>
+#include <cstring>
 #include <iostream>
-#include <sstream>
+#include <memory>
+#include "LogFields.h"
+
+/// 让GCC/Clang按printf规则检查格式字符串与参数(-Wformat)，其它编译器上为空
+#if defined(__GNUC__) || defined(__clang__)
+#define CFLOG_PRINTF_FORMAT(fmtIndex, argIndex) __attribute__((format(printf, fmtIndex, argIndex)))
+#else
+#define CFLOG_PRINTF_FORMAT(fmtIndex, argIndex)
+#endif
 
 namespace cf {
     namespace utils {
         enum class LogLevel;
-        class Log;        
+        class Log;
+
+        /**
+         * @class LogStreamBuf
+         * @brief LogStream使用的流缓冲区，直接写入预分配的字节缓冲.
+         * @details 缓冲区取自线程局部的缓冲池，析构时归还，稳定状态下一条log记录不产生任何堆分配;
+         * 只有超过kBufferSize的超长记录才会转而使用(按需增长的)堆内存.
+         */
+        class LogStreamBuf : public std::streambuf {
+        public:
+            /// 缓冲池中每块缓冲区的大小
+            static const size_t kBufferSize = 4096;
+
+            LogStreamBuf();
+            ~LogStreamBuf();
+
+            LogStreamBuf(const LogStreamBuf&) = delete;
+            LogStreamBuf& operator=(const LogStreamBuf&) = delete;
+
+            /**
+             * @brief 移动构造函数: 直接接管other的缓冲区(不拷贝数据)，other变为空
+             */
+            LogStreamBuf(LogStreamBuf&& other);
+
+            /**
+             * @brief 已写入的数据
+             */
+            const char* data() const { return pbase(); }
+            char* data() { return pbase(); }
+
+            /**
+             * @brief 已写入的字节数
+             */
+            size_t size() const { return pptr() - pbase(); }
+
+            /**
+             * @brief 按printf格式直接写入缓冲区，不产生中间字符串
+             * 
+             * @param[in] format 格式字符串
+             * @param[in] args 参数列表
+             */
+            void vprintf(const char* format, va_list args) CFLOG_PRINTF_FORMAT(2, 0);
+
+        protected:
+            int_type overflow(int_type ch) override;
+            std::streamsize xsputn(const char* s, std::streamsize n) override;
+
+        private:
+            /**
+             * @brief 扩充缓冲区，使其至少还能容纳need个字节
+             */
+            void grow(size_t need);
+
+        private:
+            char* _pooled = nullptr;        ///< 取自缓冲池的缓冲区(已转到堆内存时为空)
+            std::unique_ptr<char[]> _heap;  ///< 超长记录使用的堆内存
+        };
+
         /**
          * @class LogStream
-         * @brief Log对象使用的字符串刘，用来接收"<<"操作符输入.
+         * @brief Log对象使用的字符串流，用来接收"<<"操作符输入.
          * @warning 此类不允许被单独使用，仅能被Log类使用
          */
-        class LogStream : public std::ostringstream {
+        class LogStream : public std::ostream {
             friend class Log;
         public:
             /**
@@ -31,29 +98,96 @@ namespace cf {
              */
             ~LogStream();
 
-        private:               
+            /**
+             * @brief 已写入的log信息
+             */
+            const char* data() const { return _buf.data(); }
+
+            /**
+             * @brief 已写入的log信息的字节数
+             */
+            size_t size() const { return _buf.size(); }
+
+            /**
+             * @brief 按printf格式写入log信息(供LOGI()等宏使用)
+             * 
+             * @param[in] format 格式字符串
+             * @param[in] ... 参数列表
+             * @return LogStream& 本对象，可继续调用kv()或"<<"
+             */
+            LogStream& printf(const char* format, ...) CFLOG_PRINTF_FORMAT(2, 3);
+
+            /**
+             * @brief 为本条记录附加一个带类型的键值字段.
+             * @details 整数、浮点数、布尔值与字符串按原类型保存，由编码器(如JsonLinesEncoder)按类型输出;
+             * 其它类型经operator<<转为字符串。普通文本输出目标把字段以" key=value"的形式追加在消息之后
+             * 
+             * @param[in] key 键(超过255字节时被截断)
+             * @param[in] value 值
+             * @return LogStream& 本对象，可继续调用kv()或"<<"
+             */
+            template <typename T>
+            LogStream& kv(const char* key, const T& value) {
+                if (_pLog)
+                    writeField(key, value, std::integral_constant<bool, LogFieldWriter::isEncodable<T>::value>());
+                return *this;
+            }
+
+            /**
+             * @brief 已编码的字段
+             */
+            const char* fieldsData() const { return _fields.data(); }
+
+            /**
+             * @brief 已编码的字段的字节数
+             */
+            size_t fieldsSize() const { return _fields.size(); }
+
+        private:
+            template <typename T>
+            void writeField(const char* key, const T& value, std::true_type) {
+                LogFieldWriter::write(&_fields, key, value);
+            }
+
+            /// 不能直接编码的类型: 经operator<<写入字段缓冲区，再回填字符串长度
+            template <typename T>
+            void writeField(const char* key, const T& value, std::false_type) {
+                LogFieldWriter::writeKey(&_fields, LogFieldType::STRING, key);
+                size_t pos = _fields.size();
+                uint32_t n = 0;
+                _fields.sputn((const char*)&n, 4);
+                std::ostream os(&_fields);
+                os << value;
+                n = (uint32_t)(_fields.size() - pos - 4);
+                std::memcpy(_fields.data() + pos, &n, 4);
+            }
+               
             /**
              * @brief 构造函数
              * 
-             * @param pLog [in] pLog Log对象指针
+             * @param pLog [in] pLog Log对象指针，为空时本对象不做任何格式化、也不输出
              * @param curLevel [in] curLevel 当前Log信息的Log等级
-             * @param prefix [in] prefix 当前Log信息的前缀字符串，如等级、位置、时间等
              * @see LogLevel
              */
-            LogStream(Log* pLog, LogLevel curLevel, std::string prefix);
+            LogStream(Log* pLog, LogLevel curLevel);
 
             /**
-             * @brief LogStream拷贝构造函数
-             * @attention Gcc在RVO(返回值优化)被启用时，该拷贝构造函数不会被用上
+             * @brief LogStream移动构造函数
+             * @details 直接接管ls的缓冲区，不拷贝已写入的数据
+             * @attention Gcc在RVO(返回值优化)被启用时，该构造函数不会被用上;被移动的对象不再输出log信息
              */
-            LogStream(const LogStream& ls);
+            LogStream(LogStream&& ls);
+
+            LogStream(const LogStream&) = delete;
+            LogStream& operator=(const LogStream&) = delete;
 
         protected:
             LogLevel _curLevel;  ///< 当前待记录的Log等级
             Log* _pLog;          ///< Log指针
-            std::string _prefix; ///< Log前缀
+            LogStreamBuf _buf;   ///< 流缓冲区
+            LogStreamBuf _fields;     ///< 编码后的键值字段
+            LogRecordLayout _layout;  ///< 前缀各部分的位置
         };
 
     };
 };
-
@@ -0,0 +1,110 @@
+#include "LogTime.h"
+#include <chrono>
+#include <cstring>
+#include <ctime>
+
+namespace cf
+{
+    namespace utils
+    {
+        namespace
+        {
+            /// 每个线程、每种格式各自缓存的秒级时间字符串
+            struct TimeCache
+            {
+                std::time_t sec = -1; ///< 缓存对应的秒
+                char text[24];        ///< "YYYY-MM-DD HH:MM:SS"或"YYYY-MM-DDTHH:MM:SS"
+            };
+
+            thread_local TimeCache localCache;
+            thread_local TimeCache utcCache;
+
+            /// 输出不定长的十进制数字
+            size_t writeNumber(char *buf, uint64_t v)
+            {
+                char tmp[24];
+                int n = 0;
+                do
+                {
+                    tmp[sizeof(tmp) - 1 - n++] = (char)('0' + v % 10);
+                    v /= 10;
+                } while (v);
+                std::memcpy(buf, tmp + sizeof(tmp) - n, n);
+                return n;
+            }
+
+            /// 重新格式化秒级部分
+            void refresh(TimeCache &cache, std::time_t sec, bool utc)
+            {
+                std::tm t;
+#if defined(_WIN32) || defined(_WIN64)
+                if (utc)
+                    gmtime_s(&t, &sec);
+                else
+                    localtime_s(&t, &sec);
+#else
+                if (utc)
+                    gmtime_r(&sec, &t);
+                else
+                    localtime_r(&sec, &t);
+#endif
+                char *p = cache.text;
+                LogTime::writeDigits(p, t.tm_year + 1900, 4);
+                p[4] = '-';
+                LogTime::writeDigits(p + 5, t.tm_mon + 1, 2);
+                p[7] = '-';
+                LogTime::writeDigits(p + 8, t.tm_mday, 2);
+                p[10] = utc ? 'T' : ' ';
+                LogTime::writeDigits(p + 11, t.tm_hour, 2);
+                p[13] = ':';
+                LogTime::writeDigits(p + 14, t.tm_min, 2);
+                p[16] = ':';
+                LogTime::writeDigits(p + 17, t.tm_sec, 2);
+                cache.sec = sec;
+            }
+        }
+
+        size_t LogTime::format(char *buf, TimeFormat format, TimePrecision precision)
+        {
+            using namespace std::chrono;
+
+            if (format == TimeFormat::MONOTONIC_NS)
+                return writeNumber(buf, duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count());
+
+            return formatAt(buf, format, precision, duration_cast<nanoseconds>(system_clock::now().time_since_epoch()).count());
+        }
+
+        size_t LogTime::formatAt(char *buf, TimeFormat format, TimePrecision precision, int64_t unixNs)
+        {
+            if (format == TimeFormat::MONOTONIC_NS)
+                return writeNumber(buf, (uint64_t)unixNs);
+
+            int64_t us = unixNs / 1000;
+            std::time_t sec = (std::time_t)(us / 1000000);
+            int64_t frac = us % 1000000;
+
+            bool utc = (format == TimeFormat::UTC_ISO8601);
+            TimeCache &cache = utc ? utcCache : localCache;
+            if (cache.sec != sec)
+                refresh(cache, sec, utc);
+
+            std::memcpy(buf, cache.text, 19);
+            size_t n = 19;
+            if (precision == TimePrecision::MILLISECOND)
+            {
+                buf[n++] = '.';
+                writeDigits(buf + n, frac / 1000, 3);
+                n += 3;
+            }
+            else if (precision == TimePrecision::MICROSECOND)
+            {
+                buf[n++] = '.';
+                writeDigits(buf + n, frac, 6);
+                n += 6;
+            }
+            if (utc)
+                buf[n++] = 'Z';
+            return n;
+        }
+    };
+};
@@ -0,0 +1,92 @@
+/**
+ * @file LogTime.h
+ * @author Genleung Lan (genleung@hotmail.com)
+ * @brief log时间戳的格式化
+ * @version 0.1
+ * @date 2021-07-31
+ * 
+ * @copyright Copyright (c) 2021
+ * 
+ */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+namespace cf
+{
+    namespace utils
+    {
+        /**
+         * @brief log时间戳的格式.
+         * 
+         */
+        enum class TimeFormat : int
+        {
+            LOCAL = 0,    ///< 本地时间，如 2021-07-31 12:30:45.123
+            UTC_ISO8601,  ///< ISO-8601格式的UTC时间，如 2021-07-31T04:30:45.123Z
+            MONOTONIC_NS  ///< 单调时钟的纳秒计数(不受系统时间调整影响)，如 1234567890123
+        };
+
+        /**
+         * @brief log时间戳中秒以下部分的精度(对TimeFormat::MONOTONIC_NS无效).
+         * 
+         */
+        enum class TimePrecision : int
+        {
+            SECOND = 0,  ///< 精确到秒
+            MILLISECOND, ///< 精确到毫秒
+            MICROSECOND  ///< 精确到微秒
+        };
+
+        /**
+         * @class cf::utils::LogTime
+         * @brief log时间戳格式化工具.
+         * @details 每个线程缓存最近一次格式化好的"YYYY-MM-DD HH:MM:SS"部分，同一秒内的后续记录只需拷贝缓存，
+         * 再以手写的数字转换追加毫秒/微秒部分;仅在跨秒时才调用localtime_r/gmtime_r.
+         */
+        class LogTime
+        {
+        public:
+            /// format()写入的最大字节数
+            static const size_t kMaxLength = 40;
+
+            /**
+             * @brief 把当前时间按指定格式写入buf.
+             * 
+             * @param[out] buf 目标缓冲区，至少kMaxLength字节
+             * @param[in] format 时间戳格式
+             * @param[in] precision 秒以下部分的精度
+             * @return size_t 写入的字节数(不含结尾的'\0'，也不写入'\0')
+             */
+            static size_t format(char *buf, TimeFormat format, TimePrecision precision);
+
+            /**
+             * @brief 把指定的时刻按指定格式写入buf.
+             * 
+             * @param[out] buf 目标缓冲区，至少kMaxLength字节
+             * @param[in] format 时间戳格式(TimeFormat::MONOTONIC_NS时直接输出unixNs)
+             * @param[in] precision 秒以下部分的精度
+             * @param[in] unixNs 自1970-01-01 00:00:00 UTC起的纳秒数
+             * @return size_t 写入的字节数
+             */
+            static size_t formatAt(char *buf, TimeFormat format, TimePrecision precision, int64_t unixNs);
+
+            /**
+             * @brief 把十进制数字以固定宽度(不足补0)写入buf.
+             * 
+             * @param[out] buf 目标缓冲区
+             * @param[in] value 数值
+             * @param[in] width 宽度
+             */
+            static void writeDigits(char *buf, uint64_t value, int width)
+            {
+                for (int i = width - 1; i >= 0; i--)
+                {
+                    buf[i] = (char)('0' + value % 10);
+                    value /= 10;
+                }
+            }
+        };
+    };
+};
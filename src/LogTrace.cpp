@@ -0,0 +1,213 @@
+#include "LogTrace.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include "Log.h"
+#include "LogEncoder.h"
+
+#if !defined(_WIN32) && !defined(_WIN64)
+#include <unistd.h>
+#else
+#include <process.h>
+#endif
+
+namespace cf
+{
+    namespace utils
+    {
+        std::atomic<double> LogTraceClock::_nanosPerTick{1.0};
+        std::atomic<bool> LogTracer::_active{false};
+
+        void LogTraceClock::calibrate()
+        {
+#ifdef CFLOG_TRACE_RDTSC
+            auto t0 = std::chrono::steady_clock::now();
+            uint64_t c0 = now();
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            auto t1 = std::chrono::steady_clock::now();
+            uint64_t c1 = now();
+            double ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+            if (c1 > c0)
+                _nanosPerTick.store(ns / (double)(c1 - c0), std::memory_order_relaxed);
+#endif
+        }
+
+        struct LogTracer::ThreadBuffer
+        {
+            std::mutex mutex;          ///< 本线程追加与其它线程取出之间的互斥(几乎总是无竞争的)
+            std::vector<Event> events; ///< 已结束的span
+            long tid = 0;              ///< 写入JSON的线程号
+        };
+
+        /**
+         * @brief 线程局部的缓冲区句柄: 线程退出时写出剩余的span并注销缓冲区
+         */
+        struct LocalTraceBuffer
+        {
+            std::shared_ptr<LogTracer::ThreadBuffer> buffer;
+
+            ~LocalTraceBuffer()
+            {
+                if (!buffer)
+                    return;
+                LogTracer &tracer = LogTracer::instance();
+                std::lock_guard<std::mutex> lock(tracer._mutex);
+                tracer.drainLocked(*buffer);
+                auto &buffers = tracer._buffers;
+                buffers.erase(std::remove(buffers.begin(), buffers.end(), buffer), buffers.end());
+            }
+        };
+
+        LogTracer &LogTracer::instance()
+        {
+            static LogTracer tracer;
+            return tracer;
+        }
+
+        LogTracer::~LogTracer()
+        {
+            stop();
+        }
+
+        LogTracer::ThreadBuffer &LogTracer::localBuffer()
+        {
+            thread_local LocalTraceBuffer local;
+            if (!local.buffer)
+            {
+                static std::atomic<long> nextTid{1};
+                local.buffer = std::make_shared<ThreadBuffer>();
+                local.buffer->tid = nextTid.fetch_add(1, std::memory_order_relaxed);
+                local.buffer->events.reserve(kEventsPerThread);
+                std::lock_guard<std::mutex> lock(_mutex);
+                _buffers.push_back(local.buffer);
+            }
+            return *local.buffer;
+        }
+
+        bool LogTracer::start(const std::string &file)
+        {
+            stop();
+            LogTraceClock::calibrate();
+
+            std::lock_guard<std::mutex> lock(_mutex);
+            _out.open(file, std::ios::out | std::ios::trunc | std::ios::binary);
+            if (!_out.is_open())
+                return false;
+            _out << "[\n";
+            _firstEvent = true;
+            _originTicks = LogTraceClock::now();
+#if !defined(_WIN32) && !defined(_WIN64)
+            _pid = (long)getpid();
+#else
+            _pid = (long)_getpid();
+#endif
+            _tracing.store(true);
+            updateActive();
+            return true;
+        }
+
+        void LogTracer::stop()
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (!_out.is_open())
+                return;
+            // 先停止缓冲新的span，再写出已缓冲的
+            _tracing.store(false);
+            updateActive();
+            for (auto &buffer : _buffers)
+                drainLocked(*buffer);
+            _out << "\n]\n";
+            _out.close();
+        }
+
+        void LogTracer::flush()
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            for (auto &buffer : _buffers)
+                drainLocked(*buffer);
+            if (_out.is_open())
+                _out.flush();
+        }
+
+        void LogTracer::enableLogOutput(bool enabled, LogLevel level)
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _logLevel.store((int)level);
+            _logOutput.store(enabled);
+            updateActive();
+        }
+
+        void LogTracer::record(const LogSpanSite &site, uint64_t begin, uint64_t end)
+        {
+            if (_logOutput.load(std::memory_order_relaxed))
+            {
+                uint64_t ns = (uint64_t)((double)(end - begin) * LogTraceClock::nanosPerTick());
+                Log::instance()->createLogStream((LogLevel)_logLevel.load(std::memory_order_relaxed), "", site.path, site.line).kv("dur_ns", ns) << site.name;
+            }
+
+            if (_tracing.load(std::memory_order_relaxed))
+            {
+                ThreadBuffer &buffer = localBuffer();
+                std::unique_lock<std::mutex> bufferLock(buffer.mutex);
+                buffer.events.push_back(Event{&site, begin, end});
+                if (buffer.events.size() < kEventsPerThread)
+                    return;
+                bufferLock.unlock();
+
+                // 缓冲区已满: 由本线程写出
+                std::lock_guard<std::mutex> lock(_mutex);
+                drainLocked(buffer);
+            }
+        }
+
+        void LogTracer::drainLocked(ThreadBuffer &buffer)
+        {
+            std::vector<Event> events;
+            {
+                std::lock_guard<std::mutex> lock(buffer.mutex);
+                if (buffer.events.empty())
+                    return;
+                events.swap(buffer.events);
+                buffer.events.reserve(kEventsPerThread);
+            }
+            if (_out.is_open())
+                writeEvents(events, buffer.tid);
+        }
+
+        void LogTracer::writeEvents(const std::vector<Event> &events, long tid)
+        {
+            double nsPerTick = LogTraceClock::nanosPerTick();
+            std::string json;
+            json.reserve(events.size() * 192);
+            char num[64];
+
+            for (const Event &e : events)
+            {
+                // 在start()之前开始的span没有合法的时间戳
+                if (e.begin < _originTicks)
+                    continue;
+
+                if (!_firstEvent)
+                    json += ",\n";
+                _firstEvent = false;
+
+                json += "{\"name\":";
+                JsonLinesEncoder::appendString(json, e.site->name, std::strlen(e.site->name));
+                int n = std::snprintf(num, sizeof(num), ",\"cat\":\"cflog\",\"ph\":\"X\",\"pid\":%ld,\"tid\":%ld", _pid, tid);
+                json.append(num, n);
+                n = std::snprintf(num, sizeof(num), ",\"ts\":%.3f,\"dur\":%.3f",
+                                  (double)(e.begin - _originTicks) * nsPerTick / 1000.0,
+                                  (double)(e.end - e.begin) * nsPerTick / 1000.0);
+                json.append(num, n);
+                json += ",\"args\":{\"file\":";
+                JsonLinesEncoder::appendString(json, e.site->file, std::strlen(e.site->file));
+                n = std::snprintf(num, sizeof(num), ",\"line\":%d,\"function\":", e.site->line);
+                json.append(num, n);
+                JsonLinesEncoder::appendString(json, e.site->function, std::strlen(e.site->function));
+                json += "}}";
+            }
+            _out.write(json.data(), (std::streamsize)json.size());
+        }
+    };
+};
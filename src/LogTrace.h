@@ -0,0 +1,232 @@
+/**
+ * @file LogTrace.h
+ * @author Genleung Lan (genleung@hotmail.com)
+ * @brief 作用域计时(span)，输出为log记录或Chrome trace-event JSON
+ * @version 0.1
+ * @date 2021-07-31
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "LogSite.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#include <x86intrin.h>
+#define CFLOG_TRACE_RDTSC 1
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define CFLOG_TRACE_RDTSC 1
+#endif
+
+#define CFLOG_CONCAT_(a, b) a##b
+#define CFLOG_CONCAT(a, b) CFLOG_CONCAT_(a, b)
+
+/**
+ * @brief 对所在作用域计时: 进入时记下开始时刻，离开时把这一段(span)交给LogTracer.
+ * @details 未调用LogTracer::start()或LogTracer::enableLogOutput()时，只有一次原子读的开销
+ * @param name span的名字，必须是字符串字面量(或生命期不短于进程的字符串)
+ */
+#define TRACE_SCOPE(name) \
+    static const cf::utils::LogSpanSite CFLOG_CONCAT(_cflogSpanSite, __LINE__)(name, __FILE__, __LINE__, __FUNCTION__); \
+    cf::utils::LogSpan CFLOG_CONCAT(_cflogSpan, __LINE__)(CFLOG_CONCAT(_cflogSpanSite, __LINE__))
+
+namespace cf
+{
+    namespace utils
+    {
+        enum class LogLevel : int;
+
+        /**
+         * @class cf::utils::LogTraceClock
+         * @brief span使用的时钟.
+         * @details x86上直接读取时间戳计数器(rdtsc，要求CPU的TSC频率恒定，现代x86处理器均满足)，
+         * 在LogTracer启动时以std::chrono::steady_clock校准;其它平台使用steady_clock(纳秒)
+         */
+        class LogTraceClock
+        {
+        public:
+            /**
+             * @brief 当前时刻(时钟周期数)
+             */
+            static uint64_t now()
+            {
+#ifdef CFLOG_TRACE_RDTSC
+                return __rdtsc();
+#else
+                return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+            }
+
+            /**
+             * @brief 以steady_clock校准每个时钟周期的纳秒数(阻塞约20毫秒;非x86平台立即返回)
+             */
+            static void calibrate();
+
+            /**
+             * @brief 每个时钟周期的纳秒数(未校准时为1)
+             */
+            static double nanosPerTick() { return _nanosPerTick.load(std::memory_order_relaxed); }
+
+        private:
+            static std::atomic<double> _nanosPerTick; ///< 每个时钟周期的纳秒数
+        };
+
+        /**
+         * @class cf::utils::LogSpanSite
+         * @brief 一个TRACE_SCOPE调用点的信息，由宏在调用点定义为静态对象
+         */
+        struct LogSpanSite
+        {
+            constexpr LogSpanSite(const char *spanName, const char *srcFile, int srcLine, const char *func)
+                : name(spanName), path(srcFile), file(LogSite::basename(srcFile)), line(srcLine), function(func)
+            {
+            }
+
+            const char *name;     ///< span的名字
+            const char *path;     ///< 源文件的完整路径
+            const char *file;     ///< 源文件名(不含路径)
+            const int line;       ///< 行号
+            const char *function; ///< 所在函数
+        };
+
+        /**
+         * @class cf::utils::LogTracer
+         * @brief 收集TRACE_SCOPE产生的span.
+         * @details 两种输出方式可同时使用:
+         * 1. start(): 各线程把结束的span追加到自己的缓冲区(只有一个无竞争的互斥量)，缓冲区满、线程退出、flush()或stop()时
+         * 整块转为Chrome trace-event JSON(数组格式，"ph":"X"的完整事件)写入文件，可用chrome://tracing或Perfetto查看;
+         * 缓冲区满时的转换与写入由该线程完成。进程崩溃时文件缺少结尾的']'，这两个工具都能接受
+         * 2. enableLogOutput(): 每个span结束时经单例Log输出一条记录，消息为span的名字，字段dur_ns为耗时(纳秒)
+         */
+        class LogTracer
+        {
+        public:
+            /// 每个线程缓冲的span数，满后由该线程写出
+            static const size_t kEventsPerThread = 4096;
+
+            /// 一个结束的span
+            struct Event
+            {
+                const LogSpanSite *site; ///< 调用点
+                uint64_t begin;          ///< 开始时刻(时钟周期)
+                uint64_t end;            ///< 结束时刻(时钟周期)
+            };
+
+            /// 一个线程的缓冲区(内部使用)
+            struct ThreadBuffer;
+
+            /**
+             * @brief 获取全局唯一的LogTracer对象
+             */
+            static LogTracer &instance();
+
+            /**
+             * @brief 是否有任何一种输出被启用(TRACE_SCOPE据此决定是否计时)
+             */
+            static bool active() { return _active.load(std::memory_order_relaxed); }
+
+            ~LogTracer();
+
+            LogTracer(const LogTracer &) = delete;
+            LogTracer &operator=(const LogTracer &) = delete;
+
+            /**
+             * @brief 开始把span写入Chrome trace-event JSON文件;已在写入其它文件时先stop().
+             * @details 时间戳以本次调用的时刻为零点;会先校准时钟(阻塞约20毫秒)
+             *
+             * @param[in] file JSON文件(被覆盖)
+             * @return true 成功; false 无法打开文件
+             */
+            bool start(const std::string &file);
+
+            /**
+             * @brief 写出各线程缓冲的span，结束JSON文件并关闭之
+             */
+            void stop();
+
+            /**
+             * @brief 写出各线程缓冲的span(不关闭文件)
+             */
+            void flush();
+
+            /**
+             * @brief 启用或关闭以log记录输出span
+             *
+             * @param[in] enabled 是否启用
+             * @param[in] level 记录的等级
+             */
+            void enableLogOutput(bool enabled, LogLevel level);
+
+            /**
+             * @brief 记录一个结束的span(由LogSpan调用)
+             */
+            void record(const LogSpanSite &site, uint64_t begin, uint64_t end);
+
+        private:
+            LogTracer() = default;
+
+            /// 调用线程的缓冲区(必要时登记)
+            ThreadBuffer &localBuffer();
+
+            /// 把一个线程的span转为JSON写入文件(已持有_mutex)
+            void writeEvents(const std::vector<Event> &events, long tid);
+
+            /// 取出并写出一个线程缓冲的span(已持有_mutex)
+            void drainLocked(ThreadBuffer &buffer);
+
+            /// 更新_active
+            void updateActive() { _active.store(_tracing.load() || _logOutput.load()); }
+
+            friend struct LocalTraceBuffer;
+
+        private:
+            static std::atomic<bool> _active;          ///< 是否有任何一种输出被启用
+
+            std::atomic<bool> _tracing{false};         ///< 是否正在写入JSON文件
+            std::atomic<bool> _logOutput{false};       ///< 是否以log记录输出
+            std::atomic<int> _logLevel{0};             ///< 以log记录输出时的等级
+            std::mutex _mutex;                         ///< 保护以下成员
+            std::vector<std::shared_ptr<ThreadBuffer>> _buffers; ///< 已登记的线程缓冲区
+            std::ofstream _out;                        ///< JSON文件
+            bool _firstEvent = true;                   ///< 下一个事件前是否不需要逗号
+            uint64_t _originTicks = 0;                 ///< 时间戳的零点(时钟周期)
+            long _pid = 0;                             ///< 写入JSON的进程号
+        };
+
+        /**
+         * @class cf::utils::LogSpan
+         * @brief TRACE_SCOPE定义的计时对象(RAII)
+         */
+        class LogSpan
+        {
+        public:
+            explicit LogSpan(const LogSpanSite &site)
+                : _site(site), _begin(LogTracer::active() ? LogTraceClock::now() : 0)
+            {
+            }
+
+            ~LogSpan()
+            {
+                if (_begin)
+                    LogTracer::instance().record(_site, _begin, LogTraceClock::now());
+            }
+
+            LogSpan(const LogSpan &) = delete;
+            LogSpan &operator=(const LogSpan &) = delete;
+
+        private:
+            const LogSpanSite &_site; ///< 调用点
+            uint64_t _begin;          ///< 开始时刻，0表示未计时
+        };
+    };
+};
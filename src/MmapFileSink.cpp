@@ -0,0 +1,252 @@
+#include "MmapFileSink.h"
+
+#if !defined(_WIN32) && !defined(_WIN64)
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <thread>
+#include <unistd.h>
+
+namespace cf
+{
+    namespace utils
+    {
+        /**
+         * @details 写入线程先把writers加1，再检查retired;切换分段的线程先置retired，再等待writers归零(均为seq_cst):
+         * 两者必有其一看到对方，因而分段被解除映射时不会有线程仍在向其中拷贝
+         */
+        struct MmapFileSink::Segment
+        {
+            size_t index = 0;                     ///< 分段编号
+            std::string path;                     ///< 分段的文件名
+            int fd = -1;                          ///< 文件描述符
+            char *base = nullptr;                 ///< 映射区
+            size_t size = 0;                      ///< 分段大小
+            std::atomic<size_t> reserved{0};      ///< 已预留的字节数(可能超出size)
+            std::atomic<size_t> limit{SIZE_MAX};  ///< 第一次预留失败的位置，即有效数据的长度
+            std::atomic<int> writers{0};          ///< 正在写入本分段的线程数
+            std::atomic<bool> retired{false};     ///< 是否已被切换掉
+        };
+
+        namespace
+        {
+            /// 无法创建分段时重试的间隔
+            const std::chrono::seconds kRetryInterval(1);
+
+            std::string segmentPath(const std::string &file, size_t index)
+            {
+                char suffix[24];
+                std::snprintf(suffix, sizeof(suffix), ".%06zu", index);
+                return file + suffix;
+            }
+        }
+
+        MmapFileSink::MmapFileSink(const std::string &file, size_t segmentSize, bool syncOnFlush)
+            : _file(file), _syncOnFlush(syncOnFlush)
+        {
+            size_t page = (size_t)sysconf(_SC_PAGESIZE);
+            _segmentSize = (segmentSize + page - 1) / page * page;
+            if (_segmentSize == 0)
+                _segmentSize = page;
+
+            // 接在已有分段之后
+            size_t index = 0;
+            while (access(segmentPath(_file, index).c_str(), F_OK) == 0)
+                index++;
+
+            std::lock_guard<std::mutex> lock(_mutex);
+            _nextIndex = index;
+            rollLocked(nullptr);
+        }
+
+        MmapFileSink::~MmapFileSink()
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            Segment *seg = _current.exchange(nullptr);
+            if (seg)
+                retireLocked(seg);
+        }
+
+        MmapFileSink::Segment *MmapFileSink::openSegment(size_t index)
+        {
+            std::unique_ptr<Segment> seg(new Segment());
+            seg->index = index;
+            seg->path = segmentPath(_file, index);
+            seg->size = _segmentSize;
+            seg->fd = ::open(seg->path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            if (seg->fd < 0)
+                return nullptr;
+
+            // 预分配磁盘空间，避免写入映射区时因磁盘已满而收到SIGBUS;文件系统不支持时退化为ftruncate()
+            int err = posix_fallocate(seg->fd, 0, (off_t)seg->size);
+            if (err == ENOSPC || (err != 0 && ftruncate(seg->fd, (off_t)seg->size) != 0))
+            {
+                ::close(seg->fd);
+                ::unlink(seg->path.c_str());
+                return nullptr;
+            }
+
+            void *p = mmap(nullptr, seg->size, PROT_READ | PROT_WRITE, MAP_SHARED, seg->fd, 0);
+            if (p == MAP_FAILED)
+            {
+                ::close(seg->fd);
+                ::unlink(seg->path.c_str());
+                return nullptr;
+            }
+            seg->base = (char *)p;
+
+            _segments.push_back(std::move(seg));
+            return _segments.back().get();
+        }
+
+        bool MmapFileSink::rollLocked(Segment *full)
+        {
+            if (_current.load(std::memory_order_relaxed) != full)
+                return true;
+
+            // 创建失败后不在每条记录上重试，以免磁盘已满时每次写入都做一串系统调用
+            auto now = std::chrono::steady_clock::now();
+            if (now < _retryAt)
+                return false;
+            Segment *next = openSegment(_nextIndex);
+            if (next == nullptr)
+            {
+                _retryAt = now + kRetryInterval;
+                return false;
+            }
+            _nextIndex++;
+
+            // 先发布新分段，再等待旧分段上的写入完成: 等待期间其它线程已可写入新分段
+            _current.store(next, std::memory_order_release);
+            if (full)
+                retireLocked(full);
+            return true;
+        }
+
+        void MmapFileSink::retireLocked(Segment *seg)
+        {
+            seg->retired.store(true);
+            while (seg->writers.load() != 0)
+                std::this_thread::yield();
+
+            size_t used = seg->reserved.load(std::memory_order_relaxed);
+            size_t limit = seg->limit.load(std::memory_order_relaxed);
+            if (used > limit)
+                used = limit;
+            if (used > seg->size)
+                used = seg->size;
+
+            munmap(seg->base, seg->size);
+            seg->base = nullptr;
+            if (ftruncate(seg->fd, (off_t)used) != 0)
+            {
+                // 无法截掉尾部时，读取者应忽略末尾的零字节
+            }
+            ::close(seg->fd);
+            seg->fd = -1;
+        }
+
+        void MmapFileSink::write(LogLevel, const char *data, size_t len)
+        {
+            append(data, len, true);
+        }
+
+        void MmapFileSink::writeBytes(LogLevel, const char *data, size_t len)
+        {
+            append(data, len, false);
+        }
+
+        void MmapFileSink::append(const char *data, size_t len, bool newline)
+        {
+            size_t extra = newline ? 1 : 0;
+            for (;;)
+            {
+                Segment *seg = _current.load(std::memory_order_acquire);
+                if (seg == nullptr)
+                {
+                    // 尚无可用的分段(构造时创建失败)
+                    std::lock_guard<std::mutex> lock(_mutex);
+                    if (!rollLocked(nullptr))
+                    {
+                        _dropped.fetch_add(1, std::memory_order_relaxed);
+                        return;
+                    }
+                    continue;
+                }
+
+                seg->writers.fetch_add(1);
+                if (seg->retired.load())
+                {
+                    // 已被切换掉: 重新读取当前分段
+                    seg->writers.fetch_sub(1, std::memory_order_release);
+                    continue;
+                }
+
+                // 超过分段大小的文本记录被截断;二进制帧截断后无法解析，丢弃之
+                if (len + extra > seg->size)
+                {
+                    if (!newline)
+                    {
+                        seg->writers.fetch_sub(1, std::memory_order_release);
+                        _dropped.fetch_add(1, std::memory_order_relaxed);
+                        return;
+                    }
+                    len = seg->size - 1;
+                }
+                size_t need = len + extra;
+                size_t off = seg->reserved.fetch_add(need, std::memory_order_relaxed);
+                if (off + need <= seg->size)
+                {
+                    std::memcpy(seg->base + off, data, len);
+                    if (newline)
+                        seg->base[off + len] = '\n';
+                    seg->writers.fetch_sub(1, std::memory_order_release);
+                    return;
+                }
+
+                // 分段已满: 记下有效数据的长度(其后的预留均已失败)，切换到下一个分段后重试
+                size_t limit = seg->limit.load(std::memory_order_relaxed);
+                while (off < limit && !seg->limit.compare_exchange_weak(limit, off, std::memory_order_relaxed))
+                    ;
+                seg->writers.fetch_sub(1, std::memory_order_release);
+
+                std::lock_guard<std::mutex> lock(_mutex);
+                if (!rollLocked(seg))
+                {
+                    // 无法创建下一个分段: 丢弃本条记录，已满的分段仍是当前分段，下一次切换时重试
+                    _dropped.fetch_add(1, std::memory_order_relaxed);
+                    return;
+                }
+            }
+        }
+
+        void MmapFileSink::flush()
+        {
+            // 记录写入映射区即已在页缓存中，只有要求落盘时才需要msync()
+            if (!_syncOnFlush)
+                return;
+
+            std::lock_guard<std::mutex> lock(_mutex);
+            Segment *seg = _current.load(std::memory_order_relaxed);
+            if (seg == nullptr)
+                return;
+            size_t used = seg->reserved.load(std::memory_order_relaxed);
+            if (used > seg->size)
+                used = seg->size;
+            if (used > 0)
+                msync(seg->base, used, MS_SYNC);
+        }
+
+        std::string MmapFileSink::currentFile() const
+        {
+            Segment *seg = _current.load(std::memory_order_acquire);
+            return seg ? seg->path : std::string();
+        }
+    };
+};
+
+#endif
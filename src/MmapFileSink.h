@@ -0,0 +1,123 @@
+/**
+ * @file MmapFileSink.h
+ * @author Genleung Lan (genleung@hotmail.com)
+ * @brief 基于内存映射、预分配分段的log文件
+ * @version 0.1
+ * @date 2021-07-31
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include "LogSink.h"
+
+#if !defined(_WIN32) && !defined(_WIN64)
+
+namespace cf
+{
+    namespace utils
+    {
+        /**
+         * @class cf::utils::MmapFileSink
+         * @brief 把记录直接拷贝进内存映射文件的log输出目标(仅POSIX系统).
+         * @details log文件被分为若干固定大小的分段: app.log.000000、app.log.000001……(编号越大越新)。
+         * 每个分段在创建时预分配(posix_fallocate)并整体映射;写入线程以一次原子加预留一段字节，
+         * 再把记录memcpy进映射区，不加锁、也没有系统调用。分段写满时由首个发现的线程创建下一个分段，
+         * 旧分段在其上的写入全部完成后解除映射，并截掉未使用的尾部。
+         * 记录写入映射区即进入页缓存，进程崩溃后仍会由内核写回文件;此时最后一个分段的尾部是未使用的零字节。
+         * 无法创建下一个分段时(如磁盘已满、文件描述符耗尽)，记录被丢弃并计入droppedCount()，每秒重试一次
+         */
+        class MmapFileSink : public LogSink
+        {
+        public:
+            /// 默认分段大小
+            static const size_t kDefaultSegmentSize = 64 * 1024 * 1024;
+
+            /// 一个分段(内部使用)
+            struct Segment;
+
+            /**
+             * @brief 构造函数.
+             * @details 总是从一个新的分段开始: 编号接在已有分段之后，不会覆盖已有的文件
+             *
+             * @param[in] file log文件，各分段在其后加上".编号"
+             * @param[in] segmentSize 分段大小(向上取整到页大小);超过分段大小的记录被截断
+             * @param[in] syncOnFlush 每次flush()时是否调用msync()，使记录落盘
+             */
+            MmapFileSink(const std::string &file, size_t segmentSize = kDefaultSegmentSize, bool syncOnFlush = false);
+
+            /**
+             * @brief 析构函数，解除映射并截掉最后一个分段未使用的尾部
+             */
+            ~MmapFileSink();
+
+            MmapFileSink(const MmapFileSink &) = delete;
+            MmapFileSink &operator=(const MmapFileSink &) = delete;
+
+            void write(LogLevel level, const char *data, size_t len) override;
+            void writeBytes(LogLevel level, const char *data, size_t len) override;
+            void flush() override;
+
+            /**
+             * @brief 文件是否已成功打开并映射
+             */
+            bool isOpen() const { return _current.load(std::memory_order_acquire) != nullptr; }
+
+            /**
+             * @brief 当前分段的文件名
+             */
+            std::string currentFile() const;
+
+            /**
+             * @brief 因无法创建分段而丢弃的记录数
+             */
+            uint64_t droppedCount() const override { return _dropped.load(std::memory_order_relaxed); }
+
+        private:
+            /**
+             * @brief 在当前分段中预留空间并写入一条记录
+             *
+             * @param[in] newline 是否在记录后追加换行符;为false(自行分帧的数据)时超过分段大小的记录不截断，丢弃并计数
+             */
+            void append(const char *data, size_t len, bool newline);
+
+            /**
+             * @brief 创建并映射编号为index的分段
+             *
+             * @return Segment* 失败时返回空指针
+             */
+            Segment *openSegment(size_t index);
+
+            /**
+             * @brief 切换到下一个分段(已持有_mutex)
+             *
+             * @param[in] full 已写满的分段(尚无分段时为空指针);若它已不是当前分段(已被其它线程切换)则不做任何事
+             * @return true 当前分段已可写入; false 无法创建新分段(或尚未到重试时间)，full仍是当前分段
+             */
+            bool rollLocked(Segment *full);
+
+            /**
+             * @brief 等待分段上的写入全部完成，解除映射并截掉未使用的尾部(已持有_mutex)
+             */
+            void retireLocked(Segment *seg);
+
+        private:
+            std::string _file;                              ///< log文件(分段的文件名前缀)
+            size_t _segmentSize;                            ///< 分段大小
+            bool _syncOnFlush;                              ///< flush()时是否msync()
+            std::atomic<Segment *> _current{nullptr};       ///< 当前分段，写入线程无锁读取
+            size_t _nextIndex = 0;                          ///< 下一个分段的编号
+            std::chrono::steady_clock::time_point _retryAt; ///< 创建分段失败后，下次重试的时刻
+            std::atomic<uint64_t> _dropped{0};              ///< 因无法创建分段而丢弃的记录数
+            std::vector<std::unique_ptr<Segment>> _segments; ///< 所有分段的描述(持有其生命期，映射在分段写满后即解除)
+        };
+    };
+};
+
+#endif
@@ -0,0 +1,168 @@
+#include "MultiSink.h"
+#include "Log.h"
+#include <algorithm>
+
+namespace cf
+{
+    namespace utils
+    {
+        void MultiSink::addSink(std::shared_ptr<LogSink> sink)
+        {
+            addSink(sink, LogLevel::INFO);
+        }
+
+        void MultiSink::addSink(std::shared_ptr<LogSink> sink, LogLevel minLevel, std::shared_ptr<LogFormatter> formatter)
+        {
+            if (!sink)
+                return;
+            bool perThread = sink->perThread();
+            bool capture = perThread || std::dynamic_pointer_cast<MultiSink>(sink) != nullptr;
+            bool binary = formatter && formatter->binary();
+            _entries.update([&](Entries &entries)
+                            {
+                                entries.push_back(Entry{sink, minLevel, formatter, perThread, capture, binary});
+                                _capturing.store(std::count_if(entries.begin(), entries.end(), [](const Entry &e)
+                                                               { return e.capture; }));
+                            });
+        }
+
+        void MultiSink::removeSink(const std::shared_ptr<LogSink> &sink)
+        {
+            std::unique_ptr<Entries> old = _entries.update([&](Entries &entries)
+                                                           {
+                                                               auto it = std::remove_if(entries.begin(), entries.end(), [&](const Entry &e)
+                                                                                        { return e.sink == sink; });
+                                                               entries.erase(it, entries.end());
+                                                               _capturing.store(std::count_if(entries.begin(), entries.end(), [](const Entry &e)
+                                                                                              { return e.capture; }));
+                                                           });
+            // 旧列表已不再被任何写入者使用，此时刷新被移除的目标不会遗漏正在写入的记录
+            for (const Entry &e : *old)
+            {
+                if (e.sink == sink)
+                    e.sink->flush();
+            }
+        }
+
+        size_t MultiSink::size() const
+        {
+            LogSnapshot<Entries>::Reader entries(_entries);
+            return entries->size();
+        }
+
+        uint64_t MultiSink::lockWaitNanos() const
+        {
+            LogSnapshot<Entries>::Reader entries(_entries);
+            uint64_t ns = 0;
+            for (auto &e : *entries)
+                ns += e.sink->lockWaitNanos();
+            return ns;
+        }
+
+        uint64_t MultiSink::droppedCount() const
+        {
+            LogSnapshot<Entries>::Reader entries(_entries);
+            uint64_t n = 0;
+            for (auto &e : *entries)
+                n += e.sink->droppedCount();
+            return n;
+        }
+
+        void MultiSink::write(LogLevel level, const char *data, size_t len)
+        {
+            LogRecordView rec;
+            rec.level = level;
+            rec.text = data;
+            rec.textLength = len;
+            rec.fields = "";
+            rec.fieldsLength = 0;
+            rec.layout.messageOffset = 0;
+            writeRecord(rec);
+        }
+
+        void MultiSink::writeRecord(const LogRecordView &rec)
+        {
+            // 本线程的格式化结果: 每个格式化器(以及不设格式化器时的默认文本，以nullptr为键)每条记录只生成一次，
+            // 字符串的容量跨记录重复使用
+            thread_local std::vector<std::pair<LogFormatter *, std::string>> formatted;
+            size_t used = 0;
+
+            LogSnapshot<Entries>::Reader entries(_entries);
+            for (const Entry &e : *entries)
+            {
+                // perThread()的目标已由capture()在产生记录的线程上写入
+                if (rec.level < e.minLevel || e.perThread)
+                    continue;
+
+                if (!e.formatter && rec.fieldsLength == 0)
+                {
+                    e.sink->write(rec.level, rec.text, rec.textLength);
+                    continue;
+                }
+
+                LogFormatter *key = e.formatter.get();
+                size_t i = 0;
+                while (i < used && formatted[i].first != key)
+                    ++i;
+                if (i == used)
+                {
+                    if (used == formatted.size())
+                        formatted.emplace_back();
+                    formatted[i].first = key;
+                    std::string &out = formatted[i].second;
+                    out.clear();
+                    if (key)
+                    {
+                        key->format(rec, out);
+                    }
+                    else
+                    {
+                        // 与LogSink::writeRecord()相同: 字段以" key=value"的形式追加在文本之后
+                        out.assign(rec.text, rec.textLength);
+                        LogFieldReader::appendText(out, rec.fields, rec.fieldsLength);
+                    }
+                    ++used;
+                }
+                const std::string &out = formatted[i].second;
+                if (e.binary)
+                    e.sink->writeBytes(rec.level, out.data(), out.size());
+                else
+                    e.sink->write(rec.level, out.data(), out.size());
+            }
+        }
+
+        void MultiSink::capture(const LogRecordView &rec)
+        {
+            if (_capturing.load(std::memory_order_relaxed) == 0)
+                return;
+
+            LogSnapshot<Entries>::Reader entries(_entries);
+            for (const Entry &e : *entries)
+            {
+                if (!e.capture || rec.level < e.minLevel)
+                    continue;
+                if (e.perThread && e.formatter)
+                {
+                    thread_local std::string out;
+                    out.clear();
+                    e.formatter->format(rec, out);
+                    if (e.binary)
+                        e.sink->writeBytes(rec.level, out.data(), out.size());
+                    else
+                        e.sink->write(rec.level, out.data(), out.size());
+                }
+                else
+                {
+                    e.sink->capture(rec);
+                }
+            }
+        }
+
+        void MultiSink::flush()
+        {
+            LogSnapshot<Entries>::Reader entries(_entries);
+            for (const Entry &e : *entries)
+                e.sink->flush();
+        }
+    };
+};
@@ -0,0 +1,124 @@
+/**
+ * @file MultiSink.h
+ * @author Genleung Lan (genleung@hotmail.com)
+ * @brief 把一条log记录分发到多个输出目标
+ * @version 0.1
+ * @date 2021-07-31
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+#include "LogSink.h"
+#include "LogSnapshot.h"
+
+namespace cf
+{
+    namespace utils
+    {
+        /**
+         * @class cf::utils::LogFormatter
+         * @brief 输出目标的格式化器基类.
+         * @details 把Log生成的记录(已含等级、TAG、时间等前缀)改写为某个输出目标需要的形式，
+         * 例如为控制台加上颜色、为采集程序改写为JSON
+         */
+        class LogFormatter
+        {
+        public:
+            virtual ~LogFormatter() {}
+
+            /**
+             * @brief 格式化一条记录
+             *
+             * @param[in] rec Log生成的记录(含文本、前缀各部分的位置及键值字段)
+             * @param[out] out 输出结果(不含换行符);调用前已被清空，其容量会被重复使用
+             */
+            virtual void format(const LogRecordView &rec, std::string &out) = 0;
+
+            /**
+             * @brief 输出是否为自行分帧的二进制数据: 为true时MultiSink以LogSink::writeBytes()写入，不追加换行符
+             */
+            virtual bool binary() const { return false; }
+        };
+
+        /**
+         * @class cf::utils::MultiSink
+         * @brief 把每条记录分发到多个输出目标，每个目标有各自的等级阈值和格式化器.
+         * @details 记录只由Log格式化一次，未设格式化器的目标直接共享同一份字节(带键值字段的记录也只转为文本一次);
+         * 使用同一个格式化器的多个目标也只格式化一次。各目标由自身的互斥量保护，互不阻塞。
+         * 目标列表以LogSnapshot发布: 写入记录时不加锁，增删目标时拷贝列表并发布新的副本。
+         * Log自身的等级(setLogLevel())仍是总的过滤条件，应不高于各目标的阈值
+         */
+        class MultiSink : public LogSink
+        {
+        public:
+            /**
+             * @brief 添加一个输出目标，接收所有等级的记录
+             *
+             * @param[in] sink 输出目标
+             */
+            void addSink(std::shared_ptr<LogSink> sink);
+
+            /**
+             * @brief 添加一个输出目标
+             *
+             * @param[in] sink 输出目标
+             * @param[in] minLevel 该目标只接收不低于此等级的记录
+             * @param[in] formatter 该目标的格式化器，为空时原样输出
+             */
+            void addSink(std::shared_ptr<LogSink> sink, LogLevel minLevel, std::shared_ptr<LogFormatter> formatter = nullptr);
+
+            /**
+             * @brief 移除一个输出目标(移除前会刷新之)
+             *
+             * @param[in] sink 输出目标
+             */
+            void removeSink(const std::shared_ptr<LogSink> &sink);
+
+            /**
+             * @brief 输出目标的个数
+             */
+            size_t size() const;
+
+            void write(LogLevel level, const char *data, size_t len) override;
+            void writeRecord(const LogRecordView &rec) override;
+            void flush() override;
+
+            /**
+             * @brief 把记录转给perThread()的目标(以及嵌套的MultiSink);writeRecord()不再写入这些目标
+             */
+            void capture(const LogRecordView &rec) override;
+
+            /**
+             * @brief 各输出目标上等待互斥量的时间之和(纳秒)
+             */
+            uint64_t lockWaitNanos() const override;
+
+            /**
+             * @brief 各输出目标丢弃的记录数之和
+             */
+            uint64_t droppedCount() const override;
+
+        private:
+            /// 一个输出目标及其设定
+            struct Entry
+            {
+                std::shared_ptr<LogSink> sink;
+                LogLevel minLevel;
+                std::shared_ptr<LogFormatter> formatter;
+                bool perThread; ///< sink->perThread()
+                bool capture;   ///< 是否由capture()转交记录(perThread()的目标或嵌套的MultiSink)
+                bool binary;    ///< formatter->binary()，以writeBytes()写入
+            };
+
+            typedef std::vector<Entry> Entries;
+
+            LogSnapshot<Entries> _entries; ///< 输出目标列表(只读快照)
+            std::atomic<size_t> _capturing{0}; ///< 需要由capture()转交记录的目标个数，为0时capture()不进入读区
+        };
+    };
+};
@@ -0,0 +1,162 @@
+/**
+ * @file RingBuffer.h
+ * @author Genleung Lan (genleung@hotmail.com)
+ * @brief 有界无锁环形队列
+ * @version 0.1
+ * @date 2021-07-31
+ * 
+ * @copyright Copyright (c) 2021
+ * 
+ */
+
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+namespace cf
+{
+    namespace utils
+    {
+        /**
+         * @class cf::utils::RingBuffer
+         * @brief 基于序号(sequence)的有界无锁环形队列(Dmitry Vyukov算法).
+         * @details 多个生产者并发调用tryPush()，一个后台线程调用tryPop()进行消费;
+         * tryPop()本身也允许被生产者调用(用于"丢弃最旧记录"的溢出策略)，因此队列对多消费者同样安全.
+         * 每个槽位的T对象在队列生命期内被反复复用，而不是每次入队时重新构造.
+         * 
+         * @tparam T 槽位中保存的元素类型
+         */
+        template <typename T>
+        class RingBuffer
+        {
+        public:
+            /**
+             * @brief 构造函数
+             * 
+             * @param[in] capacity 队列容量，会被向上取整为2的幂
+             */
+            explicit RingBuffer(size_t capacity)
+            {
+                size_t n = 2;
+                while (n < capacity)
+                    n <<= 1;
+                _mask = n - 1;
+                _cells.reset(new Cell[n]);
+                for (size_t i = 0; i < n; i++)
+                    _cells[i].seq.store(i, std::memory_order_relaxed);
+            }
+
+            RingBuffer(const RingBuffer &) = delete;
+            RingBuffer &operator=(const RingBuffer &) = delete;
+
+            /**
+             * @brief 尝试入队.
+             * 
+             * @param[in] fill 对槽位元素进行写入的函数对象, 形如void(T&)
+             * @return true 入队成功; false 队列已满
+             */
+            template <typename F>
+            bool tryPush(F &&fill)
+            {
+                size_t pos = _tail.load(std::memory_order_relaxed);
+                for (;;)
+                {
+                    Cell &cell = _cells[pos & _mask];
+                    size_t seq = cell.seq.load(std::memory_order_acquire);
+                    intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+                    if (diff == 0)
+                    {
+                        if (_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                        {
+                            fill(cell.data);
+                            cell.seq.store(pos + 1, std::memory_order_release);
+                            return true;
+                        }
+                    }
+                    else if (diff < 0)
+                    {
+                        return false;
+                    }
+                    else
+                    {
+                        pos = _tail.load(std::memory_order_relaxed);
+                    }
+                }
+            }
+
+            /**
+             * @brief 尝试出队.
+             * 
+             * @param[in] take 对槽位元素进行读取的函数对象, 形如void(T&)
+             * @return true 出队成功; false 队列为空
+             */
+            template <typename F>
+            bool tryPop(F &&take)
+            {
+                size_t pos = _head.load(std::memory_order_relaxed);
+                for (;;)
+                {
+                    Cell &cell = _cells[pos & _mask];
+                    size_t seq = cell.seq.load(std::memory_order_acquire);
+                    intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+                    if (diff == 0)
+                    {
+                        if (_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                        {
+                            take(cell.data);
+                            cell.seq.store(pos + _mask + 1, std::memory_order_release);
+                            return true;
+                        }
+                    }
+                    else if (diff < 0)
+                    {
+                        return false;
+                    }
+                    else
+                    {
+                        pos = _head.load(std::memory_order_relaxed);
+                    }
+                }
+            }
+
+            /**
+             * @brief 已被占用的入队序号(含尚未写完的槽位).
+             */
+            size_t enqueuePos() const { return _tail.load(std::memory_order_acquire); }
+
+            /**
+             * @brief 已被占用的出队序号.
+             */
+            size_t dequeuePos() const { return _head.load(std::memory_order_acquire); }
+
+            /**
+             * @brief 队列是否为空(仅为瞬时快照).
+             */
+            bool empty() const { return dequeuePos() >= enqueuePos(); }
+
+            /**
+             * @brief 队列容量.
+             */
+            size_t capacity() const { return _mask + 1; }
+
+        private:
+            /// 队列槽位
+            struct Cell
+            {
+                std::atomic<size_t> seq; ///< 槽位序号
+                T data;                  ///< 槽位数据
+            };
+
+            std::unique_ptr<Cell[]> _cells;           ///< 槽位数组
+            size_t _mask = 0;                         ///< 下标掩码(容量-1)
+            char _pad0[64];                           ///< 填充，使_tail与_head分处不同缓存行以避免伪共享
+            std::atomic<size_t> _tail{0};             ///< 入队位置
+            char _pad1[64];
+            std::atomic<size_t> _head{0};             ///< 出队位置
+            char _pad2[64];
+        };
+    };
+};
@@ -0,0 +1,395 @@
+#include "RotatingFileSink.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#if defined(_WIN32) || defined(_WIN64)
+#include <io.h>
+#else
+#include <dirent.h>
+#endif
+#ifdef CFLOG_WITH_ZLIB
+#include <zlib.h>
+#endif
+
+namespace cf
+{
+    namespace utils
+    {
+        namespace
+        {
+            /// 滚动时改名失败后重试的间隔
+            const std::chrono::seconds kRetryInterval(1);
+
+            bool fileExists(const std::string &file)
+            {
+                std::ifstream f(file);
+                return f.good();
+            }
+
+            /// 把文件压缩为gzip格式(先写临时文件再改名)，成功后删除源文件
+            bool gzipFile(const std::string &src, const std::string &dst)
+            {
+#ifdef CFLOG_WITH_ZLIB
+                std::ifstream in(src, std::ios::binary);
+                if (!in)
+                    return false;
+
+                std::string tmp = dst + ".tmp";
+                gzFile out = gzopen(tmp.c_str(), "wb");
+                if (out == nullptr)
+                    return false;
+
+                std::vector<char> buf(64 * 1024);
+                bool ok = true;
+                while (ok && in)
+                {
+                    in.read(buf.data(), buf.size());
+                    std::streamsize n = in.gcount();
+                    if (n > 0 && gzwrite(out, buf.data(), (unsigned)n) != (int)n)
+                        ok = false;
+                }
+                if (gzclose(out) != Z_OK)
+                    ok = false;
+                in.close();
+
+                if (ok && std::rename(tmp.c_str(), dst.c_str()) == 0)
+                {
+                    std::remove(src.c_str());
+                    return true;
+                }
+                std::remove(tmp.c_str());
+#else
+                (void)src;
+                (void)dst;
+#endif
+                return false;
+            }
+
+            /// 把路径分为目录与文件名
+            void splitPath(const std::string &path, std::string &dir, std::string &base)
+            {
+                size_t pos = path.find_last_of("/\\");
+                dir = (pos == std::string::npos) ? "." : path.substr(0, pos);
+                base = (pos == std::string::npos) ? path : path.substr(pos + 1);
+            }
+
+            /// 列出目录dir中以prefix开头的文件名
+            std::vector<std::string> listFiles(const std::string &dir, const std::string &prefix)
+            {
+                std::vector<std::string> names;
+#if defined(_WIN32) || defined(_WIN64)
+                struct _finddata_t fd;
+                intptr_t h = _findfirst((dir + "/" + prefix + "*").c_str(), &fd);
+                if (h != -1)
+                {
+                    do
+                    {
+                        names.push_back(fd.name);
+                    } while (_findnext(h, &fd) == 0);
+                    _findclose(h);
+                }
+#else
+                DIR *d = opendir(dir.c_str());
+                if (d)
+                {
+                    while (struct dirent *e = readdir(d))
+                    {
+                        std::string name(e->d_name);
+                        if (name.compare(0, prefix.size(), prefix) == 0)
+                            names.push_back(name);
+                    }
+                    closedir(d);
+                }
+#endif
+                return names;
+            }
+        }
+
+        RotatingFileSink::RotatingFileSink(const std::string &file, const RotationOptions &options, bool append)
+            : _file(file), _options(options)
+        {
+#ifndef CFLOG_WITH_ZLIB
+            _options.compression = Compression::NONE;
+#endif
+            recoverPending();
+            openFile(append);
+            _thread = std::thread(&RotatingFileSink::run, this);
+        }
+
+        RotatingFileSink::~RotatingFileSink()
+        {
+            {
+                std::lock_guard<std::mutex> lock(_jobMutex);
+                _stop = true;
+                _jobCond.notify_one();
+            }
+            if (_thread.joinable())
+                _thread.join();
+
+            if (_ofs.is_open())
+            {
+                _ofs.flush();
+                _ofs.close();
+            }
+        }
+
+        void RotatingFileSink::openFile(bool append)
+        {
+            _bytes = 0;
+            if (append)
+            {
+                std::ifstream in(_file, std::ios::binary | std::ios::ate);
+                if (in)
+                    _bytes = (size_t)in.tellg();
+                _ofs.open(_file, std::ios::out | std::ios::app);
+            }
+            else
+            {
+                _ofs.open(_file, std::ios::out);
+            }
+            _nextRotation = nextBoundary(std::time(nullptr));
+        }
+
+        std::time_t RotatingFileSink::nextBoundary(std::time_t now) const
+        {
+            if (_options.interval == RotationInterval::NONE)
+                return 0;
+
+            std::tm t;
+#if defined(_WIN32) || defined(_WIN64)
+            localtime_s(&t, &now);
+#else
+            localtime_r(&now, &t);
+#endif
+            t.tm_min = 0;
+            t.tm_sec = 0;
+            if (_options.interval == RotationInterval::HOURLY)
+            {
+                t.tm_hour += 1;
+            }
+            else
+            {
+                t.tm_hour = 0;
+                t.tm_mday += 1;
+            }
+            t.tm_isdst = -1;
+            return std::mktime(&t);
+        }
+
+        void RotatingFileSink::write(LogLevel, const char *data, size_t len)
+        {
+            append(data, len, true);
+        }
+
+        void RotatingFileSink::writeBytes(LogLevel, const char *data, size_t len)
+        {
+            append(data, len, false);
+        }
+
+        void RotatingFileSink::append(const char *data, size_t len, bool newline)
+        {
+            std::unique_lock<std::mutex> lock = lockForWrite();
+
+            size_t need = len + (newline ? 1 : 0);
+            bool full = _options.maxBytes > 0 && _bytes > 0 && _bytes + need > _options.maxBytes;
+            bool due = _nextRotation > 0 && std::time(nullptr) >= _nextRotation;
+            // 改名失败后文件仍超出大小，不在每条记录上重试
+            if ((full || due) && std::chrono::steady_clock::now() >= _retryAt)
+                rotateLocked();
+
+            // 只在记录之间滚动，二进制帧不会被拆到两个文件中
+            _ofs.write(data, len);
+            if (newline)
+                _ofs.put('\n');
+            _bytes += need;
+        }
+
+        void RotatingFileSink::flush()
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _ofs.flush();
+        }
+
+        void RotatingFileSink::rotate()
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            rotateLocked();
+        }
+
+        void RotatingFileSink::rotateLocked()
+        {
+            // 关闭当前文件并改为唯一的临时文件名，然后重新打开一个新文件;其余工作交给后台线程
+            _ofs.flush();
+            _ofs.close();
+
+            std::time_t now = std::time(nullptr);
+            std::tm t;
+#if defined(_WIN32) || defined(_WIN64)
+            localtime_s(&t, &now);
+#else
+            localtime_r(&now, &t);
+#endif
+            char stamp[32];
+            std::strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &t);
+            std::string pending = _file + "." + stamp + "." + std::to_string(_seq++) + ".pending";
+
+            bool moved = std::rename(_file.c_str(), pending.c_str()) == 0;
+            openFile(!moved);
+
+            if (moved)
+            {
+                std::lock_guard<std::mutex> lock(_jobMutex);
+                _jobs.push_back(pending);
+                _jobCond.notify_one();
+            }
+            else
+            {
+                _retryAt = std::chrono::steady_clock::now() + kRetryInterval;
+            }
+        }
+
+        void RotatingFileSink::recoverPending()
+        {
+            std::string dir, base;
+            splitPath(_file, dir, base);
+            std::string prefix = base + ".";
+            const std::string suffix = ".pending";
+
+            // 临时文件名形如 <file>.<YYYYmmdd-HHMMSS>.<序号>.pending
+            std::vector<std::pair<std::string, unsigned>> found;
+            for (const std::string &name : listFiles(dir, prefix))
+            {
+                if (name.size() < prefix.size() + 15 + suffix.size() ||
+                    name.compare(name.size() - suffix.size(), suffix.size(), suffix) != 0)
+                    continue;
+                size_t seqBegin = name.find('.', prefix.size());
+                if (seqBegin == std::string::npos || seqBegin != prefix.size() + 15)
+                    continue;
+                found.emplace_back(name, (unsigned)std::strtoul(name.c_str() + seqBegin + 1, nullptr, 10));
+            }
+
+            // 按滚动顺序处理，并让本进程的序号接在其后，避免同一秒内重名
+            std::sort(found.begin(), found.end(), [&](const std::pair<std::string, unsigned> &a, const std::pair<std::string, unsigned> &b)
+                      {
+                          int c = a.first.compare(prefix.size(), 15, b.first, prefix.size(), 15);
+                          return c != 0 ? c < 0 : a.second < b.second;
+                      });
+            for (const auto &f : found)
+            {
+                _jobs.push_back(_file + f.first.substr(base.size()));
+                if (f.second >= _seq)
+                    _seq = f.second + 1;
+            }
+        }
+
+        void RotatingFileSink::run()
+        {
+            for (;;)
+            {
+                std::string pending;
+                {
+                    std::unique_lock<std::mutex> lock(_jobMutex);
+                    _jobCond.wait(lock, [&]()
+                                  { return _stop || !_jobs.empty(); });
+                    if (_jobs.empty())
+                        break;
+                    pending = _jobs.front();
+                    _jobs.pop_front();
+                }
+                archive(pending);
+            }
+        }
+
+        void RotatingFileSink::archive(const std::string &pending)
+        {
+            // 压缩失败的历史文件以不带.gz的名字保留，因此两种名字都要考虑
+            const char *const exts[] = {"", ".gz"};
+            auto exists = [&](const std::string &name)
+            { return fileExists(name) || fileExists(name + ".gz"); };
+            std::string target;
+
+            if (_options.naming == RotationNaming::INDEX)
+            {
+                // 把已有的 .1 .2 ... 依次后移一位，超出个数限制的删除
+                auto indexed = [&](size_t i)
+                { return _file + "." + std::to_string(i); };
+                size_t last = 1;
+                while (exists(indexed(last)))
+                    last++;
+                if (_options.maxFiles > 0 && last > _options.maxFiles)
+                {
+                    for (size_t i = _options.maxFiles; i < last; i++)
+                        for (const char *ext : exts)
+                            std::remove((indexed(i) + ext).c_str());
+                    last = _options.maxFiles;
+                }
+                for (size_t i = last; i > 1; i--)
+                    for (const char *ext : exts)
+                        std::rename((indexed(i - 1) + ext).c_str(), (indexed(i) + ext).c_str());
+                target = indexed(1);
+            }
+            else
+            {
+                // 临时文件名形如 <file>.<时间>.<序号>.pending，取出其中的时间部分
+                size_t begin = _file.size() + 1;
+                std::string stamp = pending.substr(begin, pending.find('.', begin) - begin);
+                target = _file + "." + stamp;
+                for (int n = 1; exists(target); n++)
+                    target = _file + "." + stamp + "-" + std::to_string(n);
+            }
+
+            if (_options.compression == Compression::GZIP && gzipFile(pending, target + ".gz"))
+            {
+                // 已压缩，源文件已删除
+            }
+            else
+            {
+                // 未压缩(或压缩失败): 不加.gz后缀，以免把纯文本当作gzip文件
+                std::rename(pending.c_str(), target.c_str());
+            }
+
+            if (_options.naming == RotationNaming::TIMESTAMP)
+                prune();
+        }
+
+        void RotatingFileSink::prune()
+        {
+            if (_options.maxFiles == 0)
+                return;
+
+            std::string dir, base;
+            splitPath(_file, dir, base);
+            std::string prefix = base + ".";
+
+            // 只统计形如 <base>.YYYYmmdd-HHMMSS... 的历史文件(不含尚未处理的.pending文件)
+            std::vector<std::string> archived;
+            for (const std::string &name : listFiles(dir, prefix))
+            {
+                if (name.size() < prefix.size() + 15 || name.find(".pending") != std::string::npos)
+                    continue;
+                if (!isdigit((unsigned char)name[prefix.size()]) || name[prefix.size() + 8] != '-')
+                    continue;
+                archived.push_back(name);
+            }
+
+            if (archived.size() <= _options.maxFiles)
+                return;
+
+            // 按(时间, 同一秒内的序号)排序，无序号者为该秒内的第一个
+            size_t stampEnd = prefix.size() + 15;
+            auto order = [stampEnd](const std::string &name)
+            {
+                int n = 0;
+                if (name.size() > stampEnd && name[stampEnd] == '-')
+                    n = std::atoi(name.c_str() + stampEnd + 1);
+                return std::make_pair(name.substr(0, stampEnd), n);
+            };
+            std::sort(archived.begin(), archived.end(), [&](const std::string &a, const std::string &b)
+                      { return order(a) < order(b); });
+            for (size_t i = 0; i + _options.maxFiles < archived.size(); i++)
+                std::remove((dir + "/" + archived[i]).c_str());
+        }
+    };
+};
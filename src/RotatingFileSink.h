@@ -0,0 +1,161 @@
+/**
+ * @file RotatingFileSink.h
+ * @author Genleung Lan (genleung@hotmail.com)
+ * @brief 按大小/时间滚动的log文件
+ * @version 0.1
+ * @date 2021-07-31
+ * 
+ * @copyright Copyright (c) 2021
+ * 
+ */
+
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <ctime>
+#include <deque>
+#include <fstream>
+#include <string>
+#include <thread>
+#include "LogSink.h"
+
+namespace cf
+{
+    namespace utils
+    {
+        /**
+         * @brief 按时间滚动的周期.
+         * 
+         */
+        enum class RotationInterval : int
+        {
+            NONE = 0, ///< 不按时间滚动
+            HOURLY,   ///< 每个整点滚动
+            DAILY     ///< 每天0点滚动
+        };
+
+        /**
+         * @brief 历史文件的命名方式.
+         * 
+         */
+        enum class RotationNaming : int
+        {
+            INDEX = 0, ///< app.log.1, app.log.2, ... (数字越大越旧)
+            TIMESTAMP  ///< app.log.20210731-123045 (滚动时刻)
+        };
+
+        /**
+         * @brief 历史文件的压缩方式.
+         * 
+         */
+        enum class Compression : int
+        {
+            NONE = 0, ///< 不压缩
+            GZIP      ///< gzip压缩为<name>.gz(需要在编译时找到zlib，否则不压缩;压缩失败的文件保留为不带.gz的<name>)
+        };
+
+        /**
+         * @brief 滚动参数.
+         * 
+         */
+        struct RotationOptions
+        {
+            size_t maxBytes = 0;                                 ///< 单个文件的最大字节数，0表示不按大小滚动
+            size_t maxFiles = 0;                                 ///< 保留的历史文件个数，0表示不限
+            RotationInterval interval = RotationInterval::NONE;  ///< 按时间滚动的周期
+            RotationNaming naming = RotationNaming::INDEX;       ///< 历史文件的命名方式
+            Compression compression = Compression::NONE;         ///< 历史文件的压缩方式
+        };
+
+        /**
+         * @class cf::utils::RotatingFileSink
+         * @brief 按大小/时间自动滚动的log文件.
+         * @details 滚动在持有本目标互斥量时进行(关闭、改名、重新打开)，因此不会丢失或交错记录;
+         * 历史文件的编号移位、压缩与清理全部交给后台线程完成，log调用线程从不等待压缩.
+         * 进程在滚动后、后台线程处理完之前退出时留下的<file>.*.pending文件，由下次构造时交给后台线程处理.
+         * 改名失败时继续写入当前文件，并且至多每秒重试一次
+         */
+        class RotatingFileSink : public LogSink
+        {
+        public:
+            /**
+             * @brief 构造函数
+             * 
+             * @param[in] file 当前log文件
+             * @param[in] options 滚动参数
+             * @param[in] append 是否以追加模式打开当前log文件
+             */
+            RotatingFileSink(const std::string &file, const RotationOptions &options, bool append = true);
+
+            /**
+             * @brief 析构函数，等待后台线程处理完已滚动的文件
+             */
+            ~RotatingFileSink();
+
+            void write(LogLevel level, const char *data, size_t len) override;
+            void writeBytes(LogLevel level, const char *data, size_t len) override;
+            void flush() override;
+
+            /**
+             * @brief 立即滚动当前文件
+             */
+            void rotate();
+
+        private:
+            /**
+             * @brief 写入一条记录(需要时先滚动)，newline为true时追加换行符
+             */
+            void append(const char *data, size_t len, bool newline);
+
+            /**
+             * @brief 打开当前log文件并计算下一个按时间滚动的时刻
+             */
+            void openFile(bool append);
+
+            /**
+             * @brief 在已持有_mutex时滚动当前文件
+             */
+            void rotateLocked();
+
+            /**
+             * @brief 把此前的进程滚动出来、但未来得及处理的.pending文件按滚动顺序加入_jobs
+             */
+            void recoverPending();
+
+            /**
+             * @brief 计算now之后的下一个按时间滚动的时刻
+             */
+            std::time_t nextBoundary(std::time_t now) const;
+
+            /**
+             * @brief 后台线程主循环: 命名、压缩、清理历史文件
+             */
+            void run();
+
+            /**
+             * @brief 把刚滚动出来的文件变为最终的历史文件
+             */
+            void archive(const std::string &pending);
+
+            /**
+             * @brief 删除超出个数限制的历史文件
+             */
+            void prune();
+
+        private:
+            std::string _file;                ///< 当前log文件
+            RotationOptions _options;         ///< 滚动参数
+            std::ofstream _ofs;               ///< 当前log文件对象
+            size_t _bytes = 0;                ///< 当前文件已写入的字节数
+            std::time_t _nextRotation = 0;    ///< 下一个按时间滚动的时刻
+            unsigned _seq = 0;                ///< 滚动序号，用于生成唯一的临时文件名
+            std::chrono::steady_clock::time_point _retryAt; ///< 改名失败后，下次重试滚动的时刻
+
+            std::mutex _jobMutex;             ///< 保护_jobs
+            std::condition_variable _jobCond; ///< 通知后台线程
+            std::deque<std::string> _jobs;    ///< 待处理的已滚动文件
+            bool _stop = false;               ///< 是否停止后台线程
+            std::thread _thread;              ///< 后台线程
+        };
+    };
+};
@@ -0,0 +1,334 @@
+#include "ShmRingSink.h"
+
+#if !defined(_WIN32) && !defined(_WIN64)
+
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace cf
+{
+    namespace utils
+    {
+        static_assert(sizeof(ShmRing::Header) <= ShmRing::kDataOffset, "ShmRing::Header does not fit in kDataOffset");
+        static_assert(sizeof(ShmRing::Slot) == 16, "ShmRing::Slot must be 16 bytes");
+
+        namespace
+        {
+            /// 槽的对齐(不小于Slot，保证环尾剩余的空间总能放下一个填充槽)
+            const size_t kSlotAlign = 16;
+
+            ShmRing::Slot *slotAt(char *data, uint64_t capacity, uint64_t pos)
+            {
+                return (ShmRing::Slot *)(data + (pos & (capacity - 1)));
+            }
+
+            /// 把环中[begin, end)清零
+            void zeroRange(char *data, uint64_t capacity, uint64_t begin, uint64_t end)
+            {
+                while (begin < end)
+                {
+                    uint64_t off = begin & (capacity - 1);
+                    uint64_t n = end - begin;
+                    if (n > capacity - off)
+                        n = capacity - off;
+                    std::memset(data + off, 0, n);
+                    begin += n;
+                }
+            }
+        }
+
+        ShmRingSink::ShmRingSink(const std::string &name, size_t capacity)
+        {
+            uint64_t cap = 64 * 1024;
+            while (cap < capacity)
+                cap <<= 1;
+            size_t mapSize = ShmRing::kDataOffset + cap;
+            std::string shm = shmName(name);
+
+            // 接管已有的、布局相同的环(保留其中尚未读出的记录)
+            int fd = shm_open(shm.c_str(), O_RDWR, 0);
+            if (fd >= 0)
+            {
+                struct stat st;
+                if (fstat(fd, &st) == 0 && (size_t)st.st_size == mapSize)
+                {
+                    void *p = mmap(nullptr, mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+                    if (p != MAP_FAILED)
+                    {
+                        ShmRing::Header *h = (ShmRing::Header *)p;
+                        if (h->magic.load(std::memory_order_acquire) == ShmRing::kMagic && h->version == ShmRing::kVersion && h->capacity == cap)
+                        {
+                            _header = h;
+                            _mapSize = mapSize;
+                        }
+                        else
+                        {
+                            munmap(p, mapSize);
+                        }
+                    }
+                }
+                ::close(fd);
+            }
+
+            if (_header == nullptr)
+            {
+                // 新建: 先删除旧对象，仍映射着它的收集进程不受影响(不会因文件被截短而收到SIGBUS)
+                shm_unlink(shm.c_str());
+                fd = shm_open(shm.c_str(), O_RDWR | O_CREAT | O_EXCL, 0660);
+                if (fd < 0)
+                    return;
+                if (ftruncate(fd, (off_t)mapSize) != 0)
+                {
+                    ::close(fd);
+                    shm_unlink(shm.c_str());
+                    return;
+                }
+                void *p = mmap(nullptr, mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+                ::close(fd);
+                if (p == MAP_FAILED)
+                {
+                    shm_unlink(shm.c_str());
+                    return;
+                }
+                // 新对象的内容全为零，即各原子量的初值
+                _header = (ShmRing::Header *)p;
+                _mapSize = mapSize;
+                _header->version = ShmRing::kVersion;
+                _header->capacity = cap;
+            }
+
+            _data = (char *)_header + ShmRing::kDataOffset;
+            _header->recovered.store(_header->head.load());
+            _header->pid.store((int32_t)getpid());
+            _header->closed.store(0);
+            _header->magic.store(ShmRing::kMagic, std::memory_order_release);
+        }
+
+        ShmRingSink::~ShmRingSink()
+        {
+            if (_header == nullptr)
+                return;
+            _header->closed.store(1, std::memory_order_release);
+            munmap(_header, _mapSize);
+        }
+
+        void ShmRingSink::write(LogLevel level, const char *data, size_t len)
+        {
+            push(level, data, len, nullptr, 0);
+        }
+
+        void ShmRingSink::writeRecord(const LogRecordView &rec)
+        {
+            // 字段以编码形式写入，由收集进程转为文本
+            push(rec.level, rec.text, rec.textLength, rec.fields, rec.fieldsLength);
+        }
+
+        uint64_t ShmRingSink::droppedCount() const
+        {
+            return _header ? _header->dropped.load(std::memory_order_relaxed) : 0;
+        }
+
+        void ShmRingSink::push(LogLevel level, const char *text, size_t textLength, const char *fields, size_t fieldsLength)
+        {
+            if (_header == nullptr)
+                return;
+
+            uint64_t cap = _header->capacity;
+            size_t maxPayload = cap / 4 - sizeof(ShmRing::Slot);
+            if (textLength + fieldsLength > maxPayload)
+            {
+                fieldsLength = 0;
+                if (textLength > maxPayload)
+                    textLength = maxPayload;
+            }
+            uint64_t need = (sizeof(ShmRing::Slot) + textLength + fieldsLength + kSlotAlign - 1) & ~(uint64_t)(kSlotAlign - 1);
+
+            // 预留: 环尾放不下时连同填充槽一起预留
+            uint64_t pos = _header->head.load(std::memory_order_relaxed);
+            uint64_t pad;
+            for (;;)
+            {
+                uint64_t room = cap - (pos & (cap - 1));
+                pad = room < need ? room : 0;
+                if (pos + pad + need - _header->tail.load(std::memory_order_acquire) > cap)
+                {
+                    _header->dropped.fetch_add(1, std::memory_order_relaxed);
+                    return;
+                }
+                if (_header->head.compare_exchange_weak(pos, pos + pad + need, std::memory_order_relaxed))
+                    break;
+            }
+
+            if (pad)
+            {
+                ShmRing::Slot *p = slotAt(_data, cap, pos);
+                p->size.store((uint32_t)pad, std::memory_order_relaxed);
+                p->state.store(ShmRing::kCommitted | ShmRing::kPadding, std::memory_order_release);
+                pos += pad;
+            }
+
+            ShmRing::Slot *s = slotAt(_data, cap, pos);
+            s->size.store((uint32_t)need, std::memory_order_relaxed);
+            s->textLength = (uint32_t)textLength;
+            s->fieldsLength = (uint32_t)fieldsLength;
+            char *payload = (char *)(s + 1);
+            std::memcpy(payload, text, textLength);
+            if (fieldsLength)
+                std::memcpy(payload + textLength, fields, fieldsLength);
+            s->state.store(ShmRing::kCommitted | ((uint32_t)level << 8), std::memory_order_release);
+        }
+
+        ShmRingReader::ShmRingReader(const std::string &name)
+            : _name(name)
+        {
+        }
+
+        ShmRingReader::~ShmRingReader()
+        {
+            detach();
+        }
+
+        bool ShmRingReader::attach()
+        {
+            if (_header)
+                return true;
+
+            int fd = shm_open(ShmRingSink::shmName(_name).c_str(), O_RDWR, 0);
+            if (fd < 0)
+                return false;
+            struct stat st;
+            if (fstat(fd, &st) != 0 || (size_t)st.st_size <= ShmRing::kDataOffset)
+            {
+                ::close(fd);
+                return false;
+            }
+            size_t mapSize = (size_t)st.st_size;
+            void *p = mmap(nullptr, mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            ::close(fd);
+            if (p == MAP_FAILED)
+                return false;
+
+            ShmRing::Header *h = (ShmRing::Header *)p;
+            if (h->magic.load(std::memory_order_acquire) != ShmRing::kMagic || h->version != ShmRing::kVersion ||
+                h->capacity + ShmRing::kDataOffset != mapSize)
+            {
+                munmap(p, mapSize);
+                return false;
+            }
+            _header = h;
+            _data = (char *)p + ShmRing::kDataOffset;
+            _mapSize = mapSize;
+
+            // 同名的生产者删除旧对象后新建了环(而不是接管): 以inode区分，其计数从0开始
+            if (_generation == 0 || (uint64_t)st.st_dev != _dev || (uint64_t)st.st_ino != _ino)
+            {
+                _generation++;
+                _dev = (uint64_t)st.st_dev;
+                _ino = (uint64_t)st.st_ino;
+                _dropped = 0;
+            }
+            return true;
+        }
+
+        void ShmRingReader::detach()
+        {
+            if (_header)
+                munmap(_header, _mapSize);
+            _header = nullptr;
+            _data = nullptr;
+            _mapSize = 0;
+        }
+
+        bool ShmRingReader::producerAlive() const
+        {
+            if (_header == nullptr || _header->closed.load(std::memory_order_acquire))
+                return false;
+            pid_t pid = (pid_t)_header->pid.load(std::memory_order_relaxed);
+            return kill(pid, 0) == 0 || errno == EPERM;
+        }
+
+        size_t ShmRingReader::drain(LogSink &sink)
+        {
+            if (!attach())
+                return 0;
+
+            uint64_t cap = _header->capacity;
+            bool alive = producerAlive();
+            uint64_t recovered = _header->recovered.load(std::memory_order_acquire);
+            uint64_t head = _header->head.load(std::memory_order_acquire);
+            uint64_t tail = _header->tail.load(std::memory_order_relaxed);
+            size_t count = 0;
+
+            while (tail < head)
+            {
+                ShmRing::Slot *s = slotAt(_data, cap, tail);
+                uint32_t state = s->state.load(std::memory_order_acquire);
+                uint64_t size = s->size.load(std::memory_order_relaxed);
+                bool valid = size >= sizeof(ShmRing::Slot) && size <= cap - (tail & (cap - 1)) && size % kSlotAlign == 0;
+
+                if (!(state & ShmRing::kCommitted))
+                {
+                    // 未提交: 生产者仍在写入时等待下一轮;写入它的进程已退出时跳过
+                    uint64_t orphanEnd = tail < recovered ? recovered : (alive ? 0 : head);
+                    if (orphanEnd == 0)
+                        break;
+                    if (!valid)
+                    {
+                        // 连槽的大小都未写入: 其后的边界无从得知，放弃到遗留数据的末尾
+                        zeroRange(_data, cap, tail, orphanEnd);
+                        tail = orphanEnd;
+                        _header->tail.store(tail, std::memory_order_release);
+                        continue;
+                    }
+                }
+                else if (!valid)
+                {
+                    // 数据已损坏，丢弃全部未读的记录
+                    zeroRange(_data, cap, tail, head);
+                    tail = head;
+                    _header->tail.store(tail, std::memory_order_release);
+                    break;
+                }
+                else if (!(state & ShmRing::kPadding))
+                {
+                    LogLevel level = (LogLevel)((state >> 8) & 0xff);
+                    const char *text = (const char *)(s + 1);
+                    uint32_t textLength = s->textLength;
+                    uint32_t fieldsLength = s->fieldsLength;
+                    if (sizeof(ShmRing::Slot) + (uint64_t)textLength + fieldsLength > size)
+                        textLength = fieldsLength = 0;
+                    if (fieldsLength)
+                    {
+                        _line.assign(text, textLength);
+                        LogFieldReader::appendText(_line, text + textLength, fieldsLength);
+                        sink.write(level, _line.data(), _line.size());
+                    }
+                    else
+                    {
+                        sink.write(level, text, textLength);
+                    }
+                    count++;
+                }
+
+                // 清零后再归还空间: 生产者预留到的区域总是全零，未提交的槽不会被误读
+                zeroRange(_data, cap, tail, tail + size);
+                tail += size;
+                _header->tail.store(tail, std::memory_order_release);
+            }
+
+            _dropped = _header->dropped.load(std::memory_order_relaxed);
+
+            // 生产者已退出且记录已读完: 解除映射，以便接上重新创建的环
+            if (!alive && tail == _header->head.load(std::memory_order_acquire))
+                detach();
+            return count;
+        }
+    };
+};
+
+#endif
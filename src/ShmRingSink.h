@@ -0,0 +1,202 @@
+/**
+ * @file ShmRingSink.h
+ * @author Genleung Lan (genleung@hotmail.com)
+ * @brief 经共享内存环形缓冲区把记录交给独立的收集进程(cflogd)
+ * @version 0.1
+ * @date 2021-07-31
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include "LogSink.h"
+
+#if !defined(_WIN32) && !defined(_WIN64)
+
+namespace cf
+{
+    namespace utils
+    {
+        /**
+         * @brief 共享内存环形缓冲区的布局(生产者与收集进程共用).
+         * @details 共享内存对象"/cflog-<name>"的开头是ShmRing::Header，其后kDataOffset处是capacity字节的环形数据区。
+         * 每条记录占一个按16字节对齐的槽: ShmRing::Slot头，随后是文本，再随后是编码后的字段(见LogFieldWriter)。
+         * 生产者以CAS推进head预留槽位，写入内容后以release写入state提交;收集进程按顺序读取已提交的槽，
+         * 把槽清零后推进tail。环尾放不下一条记录时以一个填充槽跳到环首。
+         * 生产者崩溃时可能留下已预留、未提交的槽: 收集进程在生产者已退出时跳过它们;
+         * 同名的生产者重新启动时把当时的head记入recovered，此前未提交的槽同样被跳过
+         */
+        namespace ShmRing
+        {
+            /// 头部的魔数，初始化完成时最后写入
+            static const uint32_t kMagic = 0x474c4663; // "cFLG"
+            /// 布局的版本
+            static const uint32_t kVersion = 1;
+            /// 数据区的偏移
+            static const size_t kDataOffset = 256;
+
+            /// Slot::state的标志位
+            static const uint32_t kCommitted = 1; ///< 已提交
+            static const uint32_t kPadding = 2;   ///< 填充槽(跳到环首)，没有记录
+
+            /// 共享内存的头部
+            struct Header
+            {
+                std::atomic<uint32_t> magic;     ///< kMagic，为其它值表示尚未初始化
+                uint32_t version;                ///< kVersion
+                uint64_t capacity;               ///< 数据区字节数(2的幂)
+                std::atomic<int32_t> pid;        ///< 生产者进程号
+                std::atomic<uint32_t> closed;    ///< 生产者是否已正常关闭
+                std::atomic<uint64_t> recovered; ///< 接管时的head: 此前未提交的槽属于已退出的生产者
+                alignas(64) std::atomic<uint64_t> head;    ///< 已预留的位置(生产者推进)
+                alignas(64) std::atomic<uint64_t> tail;    ///< 已读取的位置(收集进程推进)
+                alignas(64) std::atomic<uint64_t> dropped; ///< 因缓冲区已满而丢弃的记录数
+            };
+
+            /// 一个槽的头部
+            struct Slot
+            {
+                std::atomic<uint32_t> size;  ///< 整个槽的字节数(含本头部，16字节对齐);预留后即写入
+                std::atomic<uint32_t> state; ///< 标志位(低8位)与log等级(8~15位);提交时最后写入
+                uint32_t textLength;         ///< 文本的字节数
+                uint32_t fieldsLength;       ///< 字段的字节数
+            };
+        };
+
+        /**
+         * @class cf::utils::ShmRingSink
+         * @brief 把记录写入共享内存环形缓冲区，由独立的收集进程(cflogd)写入文件(仅POSIX系统).
+         * @details 写入只是一次CAS预留加一次memcpy，不加锁、没有系统调用;字段以编码形式传递，由收集进程转为文本。
+         * 缓冲区已满时丢弃当前记录并计数(收集进程会报告)，从不阻塞调用线程。
+         * 共享内存对象在生产者退出后依然存在，进程崩溃前已写入的记录仍会被收集进程读出;
+         * 同名的生产者重新启动时接在未读完的记录之后继续写入。每个名字只应有一个生产者进程
+         */
+        class ShmRingSink : public LogSink
+        {
+        public:
+            /// 默认数据区大小
+            static const size_t kDefaultCapacity = 4 * 1024 * 1024;
+
+            /**
+             * @brief 构造函数，创建(或接管)共享内存对象"/cflog-<name>"
+             *
+             * @param[in] name 环形缓冲区的名字(不含'/')，与cflogd的参数一致
+             * @param[in] capacity 数据区字节数(向上取整到2的幂);超过其1/4的记录被截断
+             */
+            explicit ShmRingSink(const std::string &name, size_t capacity = kDefaultCapacity);
+
+            /**
+             * @brief 析构函数，标记生产者已关闭并解除映射(不删除共享内存对象)
+             */
+            ~ShmRingSink();
+
+            ShmRingSink(const ShmRingSink &) = delete;
+            ShmRingSink &operator=(const ShmRingSink &) = delete;
+
+            void write(LogLevel level, const char *data, size_t len) override;
+            void writeRecord(const LogRecordView &rec) override;
+
+            /**
+             * @brief 共享内存是否已成功创建并映射
+             */
+            bool isOpen() const { return _header != nullptr; }
+
+            /**
+             * @brief 因缓冲区已满而丢弃的记录数
+             */
+            uint64_t droppedCount() const override;
+
+            /**
+             * @brief 共享内存对象的名字，如"/cflog-app"
+             */
+            static std::string shmName(const std::string &name) { return "/cflog-" + name; }
+
+        private:
+            /**
+             * @brief 预留一个槽并写入记录
+             */
+            void push(LogLevel level, const char *text, size_t textLength, const char *fields, size_t fieldsLength);
+
+        private:
+            ShmRing::Header *_header = nullptr; ///< 映射的头部
+            char *_data = nullptr;              ///< 映射的数据区
+            size_t _mapSize = 0;                ///< 映射的字节数
+        };
+
+        /**
+         * @class cf::utils::ShmRingReader
+         * @brief 读取ShmRingSink的环形缓冲区(收集进程使用，每个环只能有一个读取者)
+         */
+        class ShmRingReader
+        {
+        public:
+            /**
+             * @brief 构造函数
+             *
+             * @param[in] name 环形缓冲区的名字，与ShmRingSink的一致
+             */
+            explicit ShmRingReader(const std::string &name);
+            ~ShmRingReader();
+
+            ShmRingReader(const ShmRingReader &) = delete;
+            ShmRingReader &operator=(const ShmRingReader &) = delete;
+
+            /**
+             * @brief 映射共享内存(若尚未映射);生产者尚未创建或尚未初始化时返回false，可稍后重试
+             */
+            bool attach();
+
+            /**
+             * @brief 把已提交的记录逐条写入sink(字段以" key=value"的形式追加在文本之后).
+             * @details 生产者已退出(正常关闭或崩溃)时，跳过其未能提交的槽，读出其后已提交的记录
+             *
+             * @param[in] sink 输出目标
+             * @return size_t 写入的记录数
+             */
+            size_t drain(LogSink &sink);
+
+            /**
+             * @brief 生产者进程是否仍在运行
+             */
+            bool producerAlive() const;
+
+            /**
+             * @brief 生产者累计丢弃的记录数(截至最近一次drain())
+             * @details 计数属于当前映射的共享内存对象，生产者重新创建环后从0开始，见generation()
+             */
+            uint64_t droppedCount() const { return _dropped; }
+
+            /**
+             * @brief 已映射过的不同共享内存对象的个数(尚未映射时为0).
+             * @details 生产者重新创建了环(而不是接管原有的)时，重新映射后加1;droppedCount()的基准随之归零
+             */
+            unsigned generation() const { return _generation; }
+
+            /**
+             * @brief 环形缓冲区的名字
+             */
+            const std::string &name() const { return _name; }
+
+        private:
+            /// 解除映射
+            void detach();
+
+        private:
+            std::string _name;                  ///< 环形缓冲区的名字
+            ShmRing::Header *_header = nullptr; ///< 映射的头部
+            char *_data = nullptr;              ///< 映射的数据区
+            size_t _mapSize = 0;                ///< 映射的字节数
+            std::string _line;                  ///< 带字段的记录转成的文本(跨记录重复使用)
+            uint64_t _dropped = 0;              ///< 生产者累计丢弃的记录数
+            unsigned _generation = 0;           ///< 已映射过的不同共享内存对象的个数
+            uint64_t _dev = 0;                  ///< 最近映射的共享内存对象所在的设备号
+            uint64_t _ino = 0;                  ///< 最近映射的共享内存对象的inode号
+        };
+    };
+};
+
+#endif
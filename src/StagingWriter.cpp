@@ -0,0 +1,310 @@
+#include "StagingWriter.h"
+#include "Log.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace cf
+{
+    namespace utils
+    {
+        namespace
+        {
+            /// 每条记录的头部: 时间戳(8字节) + 文本长度(4字节) + 字段长度(4字节) + 等级(1字节) + 前缀各部分的位置
+            const size_t kHeaderSize = 8 + 4 + 4 + 1 + sizeof(LogRecordLayout);
+
+            std::atomic<uint64_t> nextWriterId{1};
+
+            uint64_t nowNs()
+            {
+                using namespace std::chrono;
+                return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+            }
+
+            /// 解析p处的一条记录(不含时间戳)，返回其总字节数
+            size_t readRecord(const char *p, LogRecordView &rec)
+            {
+                uint32_t textLen, fieldsLen;
+                std::memcpy(&textLen, p + 8, 4);
+                std::memcpy(&fieldsLen, p + 12, 4);
+                rec.level = (LogLevel)p[16];
+                std::memcpy(&rec.layout, p + 17, sizeof(LogRecordLayout));
+                rec.text = p + kHeaderSize;
+                rec.textLength = textLen;
+                rec.fields = rec.text + textLen;
+                rec.fieldsLength = fieldsLen;
+                return kHeaderSize + textLen + fieldsLen;
+            }
+        }
+
+        StagingWriter::StagingWriter(Log *pLog, size_t bufferSize, unsigned maxStalenessMs, size_t maxPending, OverflowPolicy policy)
+            : _pLog(pLog), _id(nextWriterId++), _bufferSize(bufferSize),
+              _maxStalenessNs((uint64_t)maxStalenessMs * 1000000), _maxPending(maxPending ? maxPending : 1), _policy(policy)
+        {
+            // 待合并的缓冲区个数有上限: 合并线程写出一批的同时生产者又可交付一批，按两倍上限预留
+            _full.reserve(_maxPending);
+            _spare.reserve(2 * _maxPending);
+            _batch.reserve(2 * _maxPending);
+            _cursors.reserve(2 * _maxPending);
+            _thread = std::thread(&StagingWriter::run, this);
+        }
+
+        StagingWriter::~StagingWriter()
+        {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _stop = true;
+                _wakeCond.notify_one();
+                _spaceCond.notify_all();
+            }
+            if (_thread.joinable())
+                _thread.join();
+
+            drain(true);
+
+            std::vector<std::shared_ptr<Buffer>> buffers;
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                buffers.swap(_buffers);
+            }
+            for (auto &b : buffers)
+            {
+                std::lock_guard<std::mutex> bufLock(b->mutex);
+                b->closed = true;
+            }
+        }
+
+        StagingWriter::Buffer &StagingWriter::localBuffer()
+        {
+            // 线程局部登记表: 写入器编号 -> 本线程在该写入器中的缓冲区
+            thread_local std::vector<std::pair<uint64_t, std::shared_ptr<Buffer>>> local;
+
+            for (auto &e : local)
+            {
+                if (e.first == _id)
+                    return *e.second;
+            }
+
+            // 顺便清理已销毁的写入器留下的缓冲区
+            local.erase(std::remove_if(local.begin(), local.end(), [](const std::pair<uint64_t, std::shared_ptr<Buffer>> &e)
+                                       {
+                                           std::lock_guard<std::mutex> lock(e.second->mutex);
+                                           return e.second->closed; }),
+                        local.end());
+
+            std::shared_ptr<Buffer> buf = std::make_shared<Buffer>();
+            buf->bytes.reserve(_bufferSize);
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _buffers.push_back(buf);
+            }
+            local.emplace_back(_id, buf);
+            return *buf;
+        }
+
+        bool StagingWriter::push(const LogRecordView &rec)
+        {
+            Buffer &buf = localBuffer();
+            uint64_t ts = nowNs();
+            uint32_t textLen = (uint32_t)rec.textLength;
+            uint32_t fieldsLen = (uint32_t)rec.fieldsLength;
+            char header[kHeaderSize];
+            std::memcpy(header, &ts, 8);
+            std::memcpy(header + 8, &textLen, 4);
+            std::memcpy(header + 12, &fieldsLen, 4);
+            header[16] = (char)rec.level;
+            std::memcpy(header + 17, &rec.layout, sizeof(LogRecordLayout));
+
+            size_t len = kHeaderSize + textLen + fieldsLen;
+            std::unique_lock<std::mutex> lock(buf.mutex);
+            if (!buf.bytes.empty() && buf.bytes.size() + len > _bufferSize && !handoff(buf, lock))
+            {
+                _dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            if (buf.bytes.empty())
+                buf.oldest = ts;
+            buf.bytes.append(header, kHeaderSize);
+            buf.bytes.append(rec.text, textLen);
+            buf.bytes.append(rec.fields, fieldsLen);
+            return true;
+        }
+
+        bool StagingWriter::handoff(Buffer &buf, std::unique_lock<std::mutex> &bufLock)
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            // 合并线程自身(输出目标中又写log)不受上限约束，否则会等待自己
+            bool limited = std::this_thread::get_id() != _thread.get_id();
+            while (limited && _full.size() >= _maxPending && _policy == OverflowPolicy::BLOCK && !_stop)
+            {
+                // 阻塞策略: 等合并线程取走已交付的缓冲区(drain()取走时即通知，不必等写完).
+                // 等待时放开本线程缓冲区的互斥量，否则合并线程会在收集滞留缓冲区时等待本线程
+                _wakeCond.notify_one();
+                bufLock.unlock();
+                _spaceCond.wait(lock);
+                lock.unlock();
+                bufLock.lock();
+                lock.lock();
+                // 等待期间缓冲区可能已被合并线程整块取走，此时无需再交付
+                if (buf.bytes.empty())
+                    return true;
+            }
+            if (limited && _full.size() >= _maxPending)
+            {
+                if (_policy == OverflowPolicy::DROP_NEWEST)
+                    return false;
+                if (_policy == OverflowPolicy::DROP_OLDEST)
+                    dropOldestLocked();
+            }
+            _full.emplace_back();
+            _full.back().swap(buf.bytes);
+            takeSpareLocked(buf.bytes);
+            _wakeCond.notify_one();
+            return true;
+        }
+
+        void StagingWriter::takeSpareLocked(std::string &bytes)
+        {
+            if (!_spare.empty())
+            {
+                bytes.swap(_spare.back());
+                _spare.pop_back();
+            }
+            // 提前被收走的缓冲区容量可能不足，统一补足，之后追加记录时不再逐步扩容
+            bytes.reserve(_bufferSize);
+        }
+
+        void StagingWriter::dropOldestLocked()
+        {
+            std::string &oldest = _full.front();
+            const char *p = oldest.data();
+            const char *end = p + oldest.size();
+            LogRecordView rec;
+            while (p < end)
+            {
+                p += readRecord(p, rec);
+                _pLog->_stats.dropped(rec.level);
+                _dropped.fetch_add(1, std::memory_order_relaxed);
+            }
+            oldest.clear();
+            _spare.emplace_back();
+            _spare.back().swap(oldest);
+            _full.erase(_full.begin());
+        }
+
+        void StagingWriter::flush()
+        {
+            drain(true);
+        }
+
+        void StagingWriter::drain(bool all)
+        {
+            std::lock_guard<std::mutex> drainLock(_drainMutex);
+            uint64_t now = nowNs();
+
+            // 锁的顺序始终为: 线程缓冲区的互斥量 -> _mutex (与handoff()一致)，因此这里不能在持有_mutex时锁缓冲区
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                for (auto &s : _full)
+                {
+                    _batch.emplace_back();
+                    _batch.back().swap(s);
+                }
+                _full.clear();
+                _snapshot = _buffers;
+                _spaceCond.notify_all();
+            }
+
+            for (auto &p : _snapshot)
+            {
+                Buffer &b = *p;
+                std::lock_guard<std::mutex> bufLock(b.mutex);
+                // now取于加锁之前，其间才开始写入的缓冲区oldest可能晚于now，不能直接相减(无符号数会回绕)
+                if (!b.bytes.empty() && (all || (now > b.oldest && now - b.oldest >= _maxStalenessNs)))
+                {
+                    _batch.emplace_back();
+                    _batch.back().swap(b.bytes);
+
+                    std::lock_guard<std::mutex> lock(_mutex);
+                    takeSpareLocked(b.bytes);
+                }
+            }
+            _snapshot.clear();
+
+            {
+                // 线程已退出(仅剩本写入器持有)且缓冲区已空: 不再需要登记
+                std::lock_guard<std::mutex> lock(_mutex);
+                _buffers.erase(std::remove_if(_buffers.begin(), _buffers.end(), [](const std::shared_ptr<Buffer> &p)
+                                              { return p.use_count() == 1 && p->bytes.empty(); }),
+                               _buffers.end());
+            }
+
+            if (_batch.empty())
+                return;
+
+            // 每个缓冲区内的记录已按时间有序，这里用小顶堆按时间戳归并各缓冲区(每块一个游标，不为每条记录分配空间);
+            // 时间戳相同时先写较早收集的缓冲区，与按收集顺序稳定排序的结果相同
+            auto later = [](const Cursor &a, const Cursor &b)
+            { return a.ts != b.ts ? a.ts > b.ts : a.index > b.index; };
+            _cursors.clear();
+            for (size_t i = 0; i < _batch.size(); i++)
+            {
+                const std::string &s = _batch[i];
+                if (s.empty())
+                    continue;
+                Cursor c;
+                c.p = s.data();
+                c.end = c.p + s.size();
+                c.index = i;
+                std::memcpy(&c.ts, c.p, 8);
+                _cursors.push_back(c);
+            }
+            std::make_heap(_cursors.begin(), _cursors.end(), later);
+
+            LogRecordView rec;
+            while (!_cursors.empty())
+            {
+                std::pop_heap(_cursors.begin(), _cursors.end(), later);
+                Cursor &c = _cursors.back();
+                c.p += readRecord(c.p, rec);
+                _pLog->write(rec);
+                if (c.p < c.end)
+                {
+                    std::memcpy(&c.ts, c.p, 8);
+                    std::push_heap(_cursors.begin(), _cursors.end(), later);
+                }
+                else
+                {
+                    _cursors.pop_back();
+                }
+            }
+
+            std::lock_guard<std::mutex> lock(_mutex);
+            for (auto &s : _batch)
+            {
+                s.clear();
+                _spare.emplace_back();
+                _spare.back().swap(s);
+            }
+            _batch.clear();
+        }
+
+        void StagingWriter::run()
+        {
+            auto interval = std::chrono::nanoseconds(std::max<uint64_t>(_maxStalenessNs / 2, 1000000));
+            for (;;)
+            {
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    if (_stop)
+                        break;
+                    if (_full.empty())
+                        _wakeCond.wait_for(lock, interval);
+                    if (_stop)
+                        break;
+                }
+                drain(false);
+            }
+        }
+    };
+};
@@ -0,0 +1,156 @@
+/**
+ * @file StagingWriter.h
+ * @author Genleung Lan (genleung@hotmail.com)
+ * @brief 线程局部暂存缓冲的log写入后端
+ * @version 0.1
+ * @date 2021-07-31
+ * 
+ * @copyright Copyright (c) 2021
+ * 
+ */
+
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "LogFields.h"
+
+namespace cf
+{
+    namespace utils
+    {
+        enum class LogLevel;
+        enum class OverflowPolicy : int;
+        class Log;
+
+        /**
+         * @class cf::utils::StagingWriter
+         * @brief 线程局部暂存缓冲的log写入器.
+         * @details 每个log线程把记录追加到自己的暂存缓冲区(只有本线程与合并线程会访问，几乎无竞争)，
+         * 缓冲区写满后整块交给后台合并线程，而不是逐条交付;合并线程把收集到的各缓冲区(各自已按时间有序)按时间戳归并后写入Log的输出目标.
+         * 长时间不满的缓冲区在超过最大滞留时间后也会被合并线程取走，保证不活跃线程的记录不会被无限期滞留.
+         * 待合并的缓冲区个数有上限，合并线程跟不上时按OverflowPolicy处理(与AsyncWriter相同): 阻塞交付的线程，
+         * 丢弃当前记录，或丢弃最早交付的整块缓冲区.
+         * @warning 此类不允许被单独使用，仅能被Log类使用
+         */
+        class StagingWriter
+        {
+        public:
+            /**
+             * @brief 构造函数，同时启动后台合并线程
+             * 
+             * @param[in] pLog 所属的Log对象
+             * @param[in] bufferSize 每个线程暂存缓冲区的大小
+             * @param[in] maxStalenessMs 记录在暂存缓冲区中的最大滞留时间(毫秒)
+             * @param[in] maxPending 已交付、待合并的缓冲区个数上限
+             * @param[in] policy 达到上限时的处理策略
+             */
+            StagingWriter(Log *pLog, size_t bufferSize, unsigned maxStalenessMs, size_t maxPending, OverflowPolicy policy);
+
+            /**
+             * @brief 析构函数，写出全部暂存的记录后停止后台合并线程
+             */
+            ~StagingWriter();
+
+            StagingWriter(const StagingWriter &) = delete;
+            StagingWriter &operator=(const StagingWriter &) = delete;
+
+            /**
+             * @brief 把一条log记录追加到调用线程的暂存缓冲区.
+             * 
+             * @param[in] rec log记录(文本与字段均被拷贝)
+             * @return true 成功; false 记录因待合并的缓冲区已达上限被丢弃
+             */
+            bool push(const LogRecordView &rec);
+
+            /**
+             * @brief 立即写出所有线程暂存的记录.
+             * 
+             */
+            void flush();
+
+            /**
+             * @brief 因待合并的缓冲区已达上限而被丢弃的记录数
+             */
+            uint64_t droppedCount() const { return _dropped.load(std::memory_order_relaxed); }
+
+        private:
+            /// 一个线程的暂存缓冲区
+            struct Buffer
+            {
+                std::mutex mutex;        ///< 本线程与合并线程之间的互斥量
+                std::string bytes;       ///< 按[时间戳][长度][等级][内容]顺序存放的记录
+                uint64_t oldest = 0;     ///< 缓冲区中最早一条记录的时间戳(纳秒)
+                bool closed = false;     ///< 所属StagingWriter已销毁
+            };
+
+            /// 归并时指向某个缓冲区中下一条记录的游标
+            struct Cursor
+            {
+                const char *p;   ///< 下一条记录的位置
+                const char *end; ///< 缓冲区的结束位置
+                uint64_t ts;     ///< 下一条记录的时间戳(纳秒)
+                size_t index;    ///< 缓冲区的收集顺序，时间戳相同时先写较早收集的
+            };
+
+            /**
+             * @brief 获取调用线程在本写入器中的暂存缓冲区(首次调用时创建并登记)
+             */
+            Buffer &localBuffer();
+
+            /**
+             * @brief 把写满的缓冲区内容交给合并线程，并换上一块空缓冲
+             * @param[in] buf 调用线程的缓冲区
+             * @param[in] bufLock 已锁定buf.mutex的锁，阻塞等待期间会暂时放开
+             * @return false 待合并的缓冲区已达上限且策略为DROP_NEWEST，未交付
+             */
+            bool handoff(Buffer &buf, std::unique_lock<std::mutex> &bufLock);
+
+            /**
+             * @brief 在已持有_mutex时给线程缓冲区换上一块空缓冲(优先复用_spare)
+             */
+            void takeSpareLocked(std::string &bytes);
+
+            /**
+             * @brief 在已持有_mutex时丢弃最早交付的缓冲区，按等级计入统计
+             */
+            void dropOldestLocked();
+
+            /**
+             * @brief 收集已交付的缓冲区以及滞留过久(或all为true时全部)的暂存缓冲区，排序后写出
+             */
+            void drain(bool all);
+
+            /**
+             * @brief 后台合并线程主循环
+             */
+            void run();
+
+        private:
+            Log *_pLog;                                  ///< 所属Log对象
+            uint64_t _id;                                ///< 写入器的唯一编号，用于线程局部登记表
+            size_t _bufferSize;                          ///< 暂存缓冲区大小
+            uint64_t _maxStalenessNs;                    ///< 最大滞留时间(纳秒)
+            size_t _maxPending;                          ///< 待合并的缓冲区个数上限
+            OverflowPolicy _policy;                      ///< 达到上限时的处理策略
+            std::atomic<uint64_t> _dropped{0};           ///< 被丢弃的记录数
+            std::mutex _mutex;                           ///< 保护_buffers/_full/_spare
+            std::vector<std::shared_ptr<Buffer>> _buffers; ///< 所有线程的暂存缓冲区
+            std::vector<std::string> _full;              ///< 已交付、待合并的缓冲区内容
+            std::vector<std::string> _spare;             ///< 可复用的空缓冲
+            std::mutex _drainMutex;                      ///< 保证同一时间只有一个线程在合并写出
+            std::vector<std::shared_ptr<Buffer>> _snapshot; ///< 本次合并时各线程缓冲区的快照
+            std::vector<std::string> _batch;             ///< 本次合并的缓冲区内容
+            std::vector<Cursor> _cursors;                ///< 本次合并各缓冲区的游标(按堆组织)
+            std::condition_variable _wakeCond;           ///< 唤醒合并线程
+            std::condition_variable _spaceCond;          ///< 通知因_full已满而阻塞的线程
+            bool _stop = false;                          ///< 是否停止合并线程
+            std::thread _thread;                         ///< 合并线程
+        };
+    };
+};
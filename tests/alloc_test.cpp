@@ -0,0 +1,188 @@
+/**
+ * @file alloc_test.cpp
+ * @author Genleung Lan (genleung@hotmail.com)
+ * @brief 验证稳定状态下的log调用不做堆分配(LOGI、operator<<、LOG*_FMT与kv()，同步、异步与暂存模式)
+ * @version 0.1
+ * @date 2021-07-31
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#include "Log.h"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <thread>
+
+using namespace cf::utils;
+
+namespace
+{
+    /// 本线程的堆分配次数(由下面替换的operator new累加)
+    thread_local uint64_t allocCount = 0;
+
+    /// 全部线程的堆分配次数(含异步与暂存模式的后台线程)
+    std::atomic<uint64_t> totalAllocCount{0};
+}
+
+void *operator new(std::size_t size)
+{
+    allocCount++;
+    totalAllocCount.fetch_add(1, std::memory_order_relaxed);
+    void *p = std::malloc(size ? size : 1);
+    if (p == nullptr)
+        throw std::bad_alloc();
+    return p;
+}
+
+void *operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+namespace
+{
+    /// 丢弃所有记录的输出目标;slow为true时每隔若干条记录休眠一次，让后台线程跟不上生产者
+    class NullSink : public LogSink
+    {
+    public:
+        void write(LogLevel, const char *, size_t) override
+        {
+            if (slow.load(std::memory_order_relaxed) && _records.fetch_add(1, std::memory_order_relaxed) % 16 == 15)
+                std::this_thread::sleep_for(std::chrono::microseconds(20));
+        }
+
+        static std::atomic<bool> slow;
+
+    private:
+        std::atomic<uint64_t> _records{0};
+    };
+
+    std::atomic<bool> NullSink::slow{false};
+
+    /// 预热与测量的调用次数
+    const int kWarmup = 1000;
+    const int kCalls = 10000;
+
+    /// 异步队列容量: 预热次数是其数倍，保证每个槽位都已按最长的记录分配过容量
+    const size_t kQueueCapacity = 256;
+
+    /**
+     * 暂存模式的参数: 缓冲区个数的峰值为本线程的1块、待合并的上限1块与合并线程正在写出的1块，
+     * 预热时输出目标较慢，生产者总在等待合并线程，必然达到峰值;滞留时间足够长，缓冲区不会在写满前被提前收走
+     */
+    const size_t kStagingBufferSize = 4096;
+    const unsigned kStagingStalenessMs = 60 * 1000;
+    const size_t kStagingMaxPending = 1;
+
+    /**
+     * @brief 预热后执行kCalls次call，返回其间的堆分配次数
+     */
+    template <typename F>
+    uint64_t countAllocs(F call)
+    {
+        for (int i = 0; i < kWarmup; i++)
+            call(i);
+        uint64_t before = allocCount;
+        for (int i = 0; i < kCalls; i++)
+            call(i);
+        return allocCount - before;
+    }
+
+    /**
+     * @brief 预热后执行kCalls次call并等待其写完，返回其间全部线程(含后台线程)的堆分配次数
+     * @details 预热与测量的次数相同，参数位数相同(各条记录长度一致);预热时输出目标较慢，
+     * 队列与缓冲池在后台线程跟不上时才会用到的部分也已分配
+     */
+    template <typename F>
+    uint64_t countAllAllocs(F call)
+    {
+        NullSink::slow = true;
+        for (int i = 0; i < kCalls; i++)
+            call(kCalls + i);
+        flushLog();
+        NullSink::slow = false;
+        uint64_t before = totalAllocCount.load();
+        for (int i = 0; i < kCalls; i++)
+            call(kCalls + i);
+        flushLog();
+        return totalAllocCount.load() - before;
+    }
+
+    bool check(const char *name, uint64_t allocs)
+    {
+        std::cout << name << ": " << allocs << " allocations in " << kCalls << " calls" << std::endl;
+        return allocs == 0;
+    }
+
+    /// 带字段的记录
+    void logWithFields(int i)
+    {
+        LOGI("request done").kv("id", i).kv("ratio", 0.5).kv("ok", true).kv("user", "alloc") << ", value " << i;
+    }
+}
+
+int main()
+{
+    setLogSink(std::make_shared<NullSink>());
+    setLogLevel(LogLevel::INFO);
+
+    bool ok = true;
+    ok &= check("LOGI constant", countAllocs([](int)
+                                             { LOGI("steady-state message without arguments"); }));
+    ok &= check("LOGI printf", countAllocs([](int i)
+                                           { LOGI("value %d, ratio %.3f, name %s", i, 0.5, "alloc"); }));
+    ok &= check("LOGI operator<<", countAllocs([](int i)
+                                               { LOGI("value ") << i << ", ratio " << 0.5 << ", name " << "alloc"; }));
+    ok &= check("LOGI_FMT", countAllocs([](int i)
+                                        { LOGI_FMT("value {}, ratio {}, name {}", i, 0.5, "alloc"); }));
+    ok &= check("LOGW_FMT", countAllocs([](int i)
+                                        { LOGW_FMT("value {}", i); }));
+    ok &= check("LOGI kv", countAllocs(logWithFields));
+
+    // 异步模式: 生产者只拷贝到槽位中已有容量的字符串，后台写线程交换取出后复用
+    enableAsync(true, kQueueCapacity, OverflowPolicy::BLOCK);
+    ok &= check("async LOGI printf", countAllAllocs([](int i)
+                                                     { LOGI("value %d, ratio %.3f, name %s", i, 0.5, "alloc"); }));
+    ok &= check("async LOGI kv", countAllAllocs(logWithFields));
+    ok &= check("async LOGW_FMT", countAllAllocs([](int i)
+                                                  { LOGW_FMT("value {}", i); }));
+    enableAsync(false);
+
+    // 暂存模式: 记录追加到本线程的暂存缓冲区，缓冲区在合并线程与生产者之间循环使用
+    enableStaging(true, kStagingBufferSize, kStagingStalenessMs, kStagingMaxPending);
+    ok &= check("staging LOGI printf", countAllAllocs([](int i)
+                                                       { LOGI("value %d, ratio %.3f, name %s", i, 0.5, "alloc"); }));
+    ok &= check("staging LOGI kv", countAllAllocs(logWithFields));
+    enableStaging(false);
+
+    if (!ok)
+    {
+        std::cerr << "steady-state log calls must not allocate" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,311 @@
+/**
+ * @file async_test.cpp
+ * @author Genleung Lan (genleung@hotmail.com)
+ * @brief 验证异步模式的语义: 溢出策略与丢弃计数、紧急通道、flush()与FATAL记录
+ * @version 0.1
+ * @date 2021-07-31
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#include "Log.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace cf::utils;
+
+namespace
+{
+    /// 队列容量(2的幂，不会被再取整)
+    const size_t kCapacity = 16;
+
+    /**
+     * @brief 按顺序保存消息正文的输出目标.
+     * @details 正文为"holdN"的记录在写入前阻塞，直到release()放行了第N条为止，
+     * 借此让后台写线程停在已知位置，使队列的状态确定
+     */
+    class GateSink : public LogSink
+    {
+    public:
+        void write(LogLevel, const char *, size_t) override {}
+
+        void writeRecord(const LogRecordView &rec) override
+        {
+            std::string msg(rec.text + rec.layout.messageOffset, rec.textLength - rec.layout.messageOffset);
+            std::unique_lock<std::mutex> lock(_mutex);
+            if (msg.compare(0, 4, "hold") == 0)
+            {
+                int n = std::stoi(msg.substr(4));
+                _holding = n;
+                _cond.notify_all();
+                _cond.wait(lock, [&]()
+                           { return _released > n; });
+                _holding = -1;
+            }
+            _messages.push_back(msg);
+            _cond.notify_all();
+        }
+
+        /// 放行正文为hold0 ~ hold(n-1)的记录
+        void release(int n)
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _released = n;
+            _cond.notify_all();
+        }
+
+        /// 等待后台写线程阻塞在正文为"holdN"的记录上
+        bool waitHolding(int n)
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            return _cond.wait_for(lock, std::chrono::seconds(10), [&]()
+                                  { return _holding == n; });
+        }
+
+        /// 等待已写入的记录数达到n
+        bool waitCount(size_t n)
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            return _cond.wait_for(lock, std::chrono::seconds(10), [&]()
+                                  { return _messages.size() >= n; });
+        }
+
+        std::vector<std::string> messages()
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            return _messages;
+        }
+
+    private:
+        std::mutex _mutex;
+        std::condition_variable _cond;
+        std::vector<std::string> _messages;
+        int _released = 0;
+        int _holding = -1;
+    };
+
+    /// FATAL记录不终结进程，只记下fatal()被调用过
+    class TestLog : public Log
+    {
+    public:
+        void fatal() override { fatalCalled = true; }
+
+        std::atomic<bool> fatalCalled{false};
+    };
+
+    int failures = 0;
+
+    void expect(bool cond, const char *test, const std::string &what)
+    {
+        if (!cond)
+        {
+            std::cerr << test << ": " << what << std::endl;
+            failures++;
+        }
+    }
+
+    std::vector<std::string> range(int first, int last)
+    {
+        std::vector<std::string> v;
+        for (int i = first; i <= last; i++)
+            v.push_back(std::to_string(i));
+        return v;
+    }
+
+    /**
+     * @brief 让后台写线程阻塞在hold0上，再以INFO提交1 ~ total
+     */
+    void fillQueue(TestLog &log, GateSink &sink, int total, const char *test)
+    {
+        log(LogLevel::INFO) << "hold0";
+        expect(sink.waitHolding(0), test, "writer did not pick up hold0");
+        for (int i = 1; i <= total; i++)
+            log(LogLevel::INFO) << i;
+    }
+
+    void setup(TestLog &log, std::shared_ptr<GateSink> sink, OverflowPolicy policy)
+    {
+        log.setLogSink(sink);
+        log.setLogLevel(LogLevel::INFO);
+        log.enableAsync(true, kCapacity, policy);
+    }
+
+    void testDropNewest()
+    {
+        const char *test = "DROP_NEWEST";
+        TestLog log;
+        auto sink = std::make_shared<GateSink>();
+        setup(log, sink, OverflowPolicy::DROP_NEWEST);
+
+        // 队列装满1 ~ 16，其后的17 ~ 26被丢弃
+        fillQueue(log, *sink, (int)kCapacity + 10, test);
+        expect(log.droppedCount() == 10, test, "droppedCount() = " + std::to_string(log.droppedCount()));
+        sink->release(1);
+        log.flush();
+
+        std::vector<std::string> want = range(1, (int)kCapacity);
+        want.insert(want.begin(), "hold0");
+        expect(sink->messages() == want, test, "unexpected records written");
+        expect(LogStats::total(log.stats().dropped) == 10, test, "stats().dropped does not match droppedCount()");
+    }
+
+    void testDropOldest()
+    {
+        const char *test = "DROP_OLDEST";
+        TestLog log;
+        auto sink = std::make_shared<GateSink>();
+        setup(log, sink, OverflowPolicy::DROP_OLDEST);
+
+        // 最旧的1 ~ 10被挤出，留下11 ~ 26
+        fillQueue(log, *sink, (int)kCapacity + 10, test);
+        expect(log.droppedCount() == 10, test, "droppedCount() = " + std::to_string(log.droppedCount()));
+        sink->release(1);
+        log.flush();
+
+        std::vector<std::string> want = range(11, (int)kCapacity + 10);
+        want.insert(want.begin(), "hold0");
+        expect(sink->messages() == want, test, "unexpected records written");
+        expect(LogStats::total(log.stats().dropped) == 10, test, "stats().dropped does not match droppedCount()");
+    }
+
+    void testBlock()
+    {
+        const char *test = "BLOCK";
+        TestLog log;
+        auto sink = std::make_shared<GateSink>();
+        setup(log, sink, OverflowPolicy::BLOCK);
+
+        fillQueue(log, *sink, (int)kCapacity, test);
+        std::atomic<bool> done{false};
+        std::thread producer([&]()
+                             {
+                                 log(LogLevel::INFO) << kCapacity + 1;
+                                 done = true; });
+
+        // 队列已满: 生产者应一直等待，直到写线程腾出空位
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        expect(!done, test, "producer returned while the queue was full");
+        sink->release(1);
+        producer.join();
+        log.flush();
+
+        std::vector<std::string> want = range(1, (int)kCapacity + 1);
+        want.insert(want.begin(), "hold0");
+        expect(sink->messages() == want, test, "unexpected records written");
+        expect(log.droppedCount() == 0, test, "records dropped under BLOCK");
+    }
+
+    void testUrgentLane()
+    {
+        const char *test = "urgent lane";
+        TestLog log;
+        auto sink = std::make_shared<GateSink>();
+        setup(log, sink, OverflowPolicy::DROP_NEWEST);
+
+        // 普通通道已满并开始丢弃，WARN与ERROR仍应入队，且先于积压的INFO写出
+        fillQueue(log, *sink, (int)kCapacity + 1, test);
+        log(LogLevel::WARN) << "warn";
+        log(LogLevel::ERROR) << "error";
+        expect(log.droppedCount() == 1, test, "droppedCount() = " + std::to_string(log.droppedCount()));
+        sink->release(1);
+        log.flush();
+
+        std::vector<std::string> want = range(1, (int)kCapacity);
+        want.insert(want.begin(), {"hold0", "warn", "error"});
+        expect(sink->messages() == want, test, "urgent records were not written ahead of the backlog");
+    }
+
+    void testFlush()
+    {
+        const char *test = "flush";
+        TestLog log;
+        auto sink = std::make_shared<GateSink>();
+        setup(log, sink, OverflowPolicy::BLOCK);
+
+        // 多个线程各自提交后flush()，返回时本线程之前提交的记录都应已写出
+        const int kThreads = 4;
+        const int kRecords = 1000;
+        std::atomic<int> failed{0};
+        std::vector<std::thread> threads;
+        for (int t = 0; t < kThreads; t++)
+            threads.emplace_back([&, t]()
+                                 {
+                                     for (int round = 0; round < 10; round++)
+                                     {
+                                         for (int i = 0; i < kRecords / 10; i++)
+                                             log(LogLevel::INFO) << "t" << t << "-" << round;
+                                         log.flush();
+                                         std::string last = "t" + std::to_string(t) + "-" + std::to_string(round);
+                                         int n = 0;
+                                         for (const std::string &m : sink->messages())
+                                             n += m == last;
+                                         if (n != kRecords / 10)
+                                             failed++;
+                                     } });
+        for (std::thread &t : threads)
+            t.join();
+        expect(failed == 0, test, std::to_string(failed.load()) + " flush() calls returned before their records were written");
+        expect(sink->messages().size() == (size_t)kThreads * kRecords, test, "records lost");
+    }
+
+    void testFatal()
+    {
+        const char *test = "FATAL";
+        TestLog log;
+        auto sink = std::make_shared<GateSink>();
+        setup(log, sink, OverflowPolicy::BLOCK);
+
+        // 写线程: hold0阻塞 -> 放行后先写紧急通道的warn -> 再阻塞在普通通道的hold1上
+        log(LogLevel::INFO) << "hold0";
+        expect(sink->waitHolding(0), test, "writer did not pick up hold0");
+        log(LogLevel::WARN) << "warn";
+        log(LogLevel::INFO) << "hold1";
+
+        std::thread producer([&]()
+                             { log(LogLevel::FATAL) << "fatal"; });
+
+        // 紧急通道未写完之前FATAL记录不应写出
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        expect(sink->messages().empty(), test, "fatal record written before the urgent lane");
+
+        // 紧急通道写完后FATAL记录立即写出，不等待普通通道中阻塞的hold1
+        sink->release(1);
+        expect(sink->waitCount(3), test, "fatal record waited for the normal lane");
+        std::vector<std::string> want = {"hold0", "warn", "fatal"};
+        expect(sink->messages() == want, test, "fatal record out of order");
+
+        // 终结进程前仍要写完普通通道的积压
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        expect(!log.fatalCalled, test, "fatal() called before the backlog was written");
+        sink->release(2);
+        producer.join();
+        expect(log.fatalCalled, test, "fatal() not called");
+        want.push_back("hold1");
+        expect(sink->messages() == want, test, "backlog not written before fatal()");
+    }
+}
+
+int main()
+{
+    testDropNewest();
+    testDropOldest();
+    testBlock();
+    testUrgentLane();
+    testFlush();
+    testFatal();
+
+    if (failures)
+    {
+        std::cerr << failures << " check(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << "all async checks passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,174 @@
+/**
+ * @file encoder_test.cpp
+ * @author Genleung Lan (genleung@hotmail.com)
+ * @brief 验证BinaryRecordEncoder的输出经文件类输出目标写出后，能逐条解码回原来的记录
+ * @version 0.1
+ * @date 2021-07-31
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#include "Log.h"
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#if !defined(_WIN32) && !defined(_WIN64)
+#include <unistd.h>
+#endif
+
+using namespace cf::utils;
+
+namespace
+{
+    /// 写入的一条记录及其字段
+    struct Expected
+    {
+        LogLevel level;
+        std::string tag;
+        std::string message;
+        int64_t id;
+        std::string note;
+        std::string text; ///< decode()输出中"[文件名:行号]"之后的部分
+    };
+
+    int failures = 0;
+
+    void expect(bool cond, const std::string &test, const std::string &what)
+    {
+        if (!cond)
+        {
+            std::cerr << test << ": " << what << std::endl;
+            failures++;
+        }
+    }
+
+    /**
+     * @brief 正文与字段中含有换行符;正文长度为10时长度前缀中也含有'\n'字节
+     */
+    std::vector<Expected> records()
+    {
+        return {
+            {LogLevel::INFO, "net", "hello\nworld", 7, "x\ny", "] hello\nworld id=7 note=\"x\\ny\""},
+            {LogLevel::WARN, "", "0123456789", 10, "plain", "] 0123456789 id=10 note=plain"},
+            {LogLevel::ERROR, "db", "", -1, "", "]  id=-1 note=\"\""},
+            {LogLevel::NOTICE, "net", "\n", 42, "a b", "] \n id=42 note=\"a b\""},
+        };
+    }
+
+    std::string readFile(const std::string &file)
+    {
+        std::ifstream in(file, std::ios::binary);
+        std::ostringstream ss;
+        ss << in.rdbuf();
+        return ss.str();
+    }
+
+    void writeRecords(std::shared_ptr<LogSink> sink)
+    {
+        Log log;
+        log.setLogSink(std::make_shared<MultiSink>());
+        log.addLogSink(sink, LogLevel::INFO, std::make_shared<BinaryRecordEncoder>());
+        log.setLogLevel(LogLevel::INFO);
+        int line = 1;
+        for (const Expected &e : records())
+            log.createLogStream(e.level, e.tag.c_str(), "src/app.cpp", line++).kv("id", e.id).kv("note", e.note) << e.message;
+        log.flush();
+    }
+
+    void checkRecords(const std::string &test, const std::string &data)
+    {
+        std::vector<Expected> want = records();
+        BinaryRecordReader reader(data.data(), data.size());
+        BinaryRecord rec;
+        size_t n = 0;
+        size_t payload = 0;
+        while (reader.next(rec))
+        {
+            if (n >= want.size())
+            {
+                n++;
+                break;
+            }
+            const Expected &e = want[n];
+            std::string name = test + " record " + std::to_string(n);
+            expect(rec.level == e.level, name, "level " + std::to_string((int)rec.level));
+            expect(std::string(rec.tag, rec.tagLength) == e.tag, name, "tag " + std::string(rec.tag, rec.tagLength));
+            expect(std::string(rec.pos, rec.posLength) == "app.cpp:" + std::to_string(n + 1), name, "pos " + std::string(rec.pos, rec.posLength));
+            expect(rec.timeLength > 0, name, "no time");
+            expect(std::string(rec.message, rec.messageLength) == e.message, name, "message " + std::string(rec.message, rec.messageLength));
+
+            LogFieldReader fields(rec.fields, rec.fieldsLength);
+            LogField f;
+            bool ok = fields.next(f) && std::string(f.key, f.keyLength) == "id" && f.type == LogFieldType::INT && f.i == e.id;
+            ok = ok && fields.next(f) && std::string(f.key, f.keyLength) == "note" && f.type == LogFieldType::STRING &&
+                 std::string(f.str, f.strLength) == e.note;
+            expect(ok && !fields.next(f), name, "fields do not match");
+
+            payload += 4 + 1 + 5 * 4 + rec.tagLength + rec.timeLength + rec.posLength + rec.messageLength + rec.fieldsLength;
+            n++;
+        }
+        expect(n == want.size(), test, "decoded " + std::to_string(n) + " records, expected " + std::to_string(want.size()));
+        expect(reader.atEnd(), test, "bytes left after the last decodable record");
+        expect(payload == data.size(), test, "file has " + std::to_string(data.size()) + " bytes, frames " + std::to_string(payload));
+
+        // 文本解码: 每条记录一行，字段追加在正文之后
+        std::istringstream in(data);
+        std::ostringstream out;
+        expect(BinaryRecordReader::decode(in, out), test, "decode() failed");
+        std::string text = out.str();
+        const char *levelStr[] = {"[I]", "[N]", "[W]", "[E]", "[F]"};
+        size_t pos = 0;
+        int line = 1;
+        for (const Expected &e : want)
+        {
+            std::string prefix = std::string(levelStr[(int)e.level]) + (e.tag.empty() ? "" : "[" + e.tag + "]") + "[";
+            std::string suffix = "[app.cpp:" + std::to_string(line++) + e.text + "\n";
+            bool ok = text.compare(pos, prefix.size(), prefix) == 0;
+            size_t end = text.find(suffix, pos);
+            expect(ok && end != std::string::npos, test, "decoded text does not match: " + text.substr(pos));
+            if (end == std::string::npos)
+                break;
+            pos = end + suffix.size();
+        }
+        expect(pos == text.size(), test, "extra decoded text: " + text.substr(pos));
+
+        // 截断的输入
+        std::istringstream truncated(data.substr(0, data.size() - 3));
+        std::ostringstream discard;
+        expect(!BinaryRecordReader::decode(truncated, discard), test, "truncated input decoded without error");
+    }
+
+    void run(const std::string &test, const std::string &file, std::shared_ptr<LogSink> sink)
+    {
+        writeRecords(sink);
+        sink.reset();
+        checkRecords(test, readFile(file));
+        std::remove(file.c_str());
+    }
+}
+
+int main()
+{
+#if !defined(_WIN32) && !defined(_WIN64)
+    std::string base = "cflog-encoder-test-" + std::to_string(getpid());
+#else
+    std::string base = "cflog-encoder-test";
+#endif
+    run("FileSink", base + ".rec", FileSink::open(base + ".rec", false));
+    run("RotatingFileSink", base + ".rot", std::make_shared<RotatingFileSink>(base + ".rot", RotationOptions(), false));
+#if !defined(_WIN32) && !defined(_WIN64)
+    run("FdFileSink", base + ".fd", std::make_shared<FdFileSink>(base + ".fd", false));
+#endif
+
+    if (failures)
+    {
+        std::cerr << failures << " check(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << "all binary record checks passed" << std::endl;
+    return 0;
+}
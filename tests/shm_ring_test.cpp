@@ -0,0 +1,192 @@
+/**
+ * @file shm_ring_test.cpp
+ * @author Genleung Lan (genleung@hotmail.com)
+ * @brief 验证生产者进程中途退出后，ShmRingReader仍能按顺序读出其已提交的记录，并正确报告丢弃数
+ * @version 0.1
+ * @date 2021-07-31
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#include "Log.h"
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#if !defined(_WIN32) && !defined(_WIN64)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+using namespace cf::utils;
+
+#if !defined(_WIN32) && !defined(_WIN64)
+namespace
+{
+    /// 按顺序保存读出的记录
+    class CollectSink : public LogSink
+    {
+    public:
+        void write(LogLevel, const char *data, size_t len) override { lines.emplace_back(data, len); }
+
+        std::vector<std::string> lines;
+    };
+
+    int failures = 0;
+
+    void expect(bool cond, const char *test, const std::string &what)
+    {
+        if (!cond)
+        {
+            std::cerr << test << ": " << what << std::endl;
+            failures++;
+        }
+    }
+
+    void writeRecords(ShmRingSink &sink, int first, int last)
+    {
+        for (int i = first; i <= last; i++)
+        {
+            std::string line = "rec " + std::to_string(i);
+            sink.write(LogLevel::INFO, line.data(), line.size());
+        }
+    }
+
+    /**
+     * @brief 模拟生产者在写入一条记录的中途崩溃: 预留一个槽并写入部分内容，但不提交
+     */
+    void reserveOrphanSlot(const std::string &name)
+    {
+        int fd = shm_open(ShmRingSink::shmName(name).c_str(), O_RDWR, 0);
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) != 0)
+            _exit(3);
+        void *p = mmap(nullptr, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED)
+            _exit(3);
+
+        ShmRing::Header *h = (ShmRing::Header *)p;
+        const uint32_t size = 64;
+        uint64_t pos = h->head.fetch_add(size);
+        ShmRing::Slot *s = (ShmRing::Slot *)((char *)p + ShmRing::kDataOffset + (pos & (h->capacity - 1)));
+        s->size.store(size);
+        s->textLength = 8;
+        std::memcpy((char *)(s + 1), "torn rec", 8);
+        munmap(p, (size_t)st.st_size);
+    }
+
+    /**
+     * @brief 在子进程中运行body，body返回后以_exit()退出(不执行ShmRingSink的析构，如同崩溃)
+     * @return 子进程的退出码
+     */
+    template <typename F>
+    int runProducer(F body)
+    {
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            body();
+            _exit(0);
+        }
+        int status = 0;
+        waitpid(pid, &status, 0);
+        return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+    }
+
+    std::vector<std::string> range(int first, int last)
+    {
+        std::vector<std::string> v;
+        for (int i = first; i <= last; i++)
+            v.push_back("rec " + std::to_string(i));
+        return v;
+    }
+
+    void testCrashedProducer(const std::string &name, ShmRingReader &reader)
+    {
+        const char *test = "crashed producer";
+        // 其它线程在崩溃线程的未提交槽之后仍提交了记录(rec 100 ~ 149)
+        int rc = runProducer([&]()
+                             {
+                                 ShmRingSink sink(name, 64 * 1024);
+                                 if (!sink.isOpen())
+                                     _exit(2);
+                                 writeRecords(sink, 0, 99);
+                                 reserveOrphanSlot(name);
+                                 writeRecords(sink, 100, 149); });
+        expect(rc == 0, test, "producer failed with exit code " + std::to_string(rc));
+
+        CollectSink out;
+        size_t n = reader.drain(out);
+        expect(n == 150, test, "drained " + std::to_string(n) + " records, expected 150");
+        expect(out.lines == range(0, 149), test, "records out of order, lost or torn");
+        expect(reader.drain(out) == 0, test, "ring not empty after draining");
+        expect(reader.generation() == 1, test, "generation " + std::to_string(reader.generation()));
+    }
+
+    void testDroppedThenTakenOver(const std::string &name, ShmRingReader &reader)
+    {
+        const char *test = "taken-over ring";
+        // 同样大小的环被接管: 同一共享内存对象，丢弃计数延续;写入远超容量的记录，溢出的被丢弃
+        const int kRecords = 4000;
+        int rc = runProducer([&]()
+                             {
+                                 ShmRingSink sink(name, 64 * 1024);
+                                 writeRecords(sink, 0, kRecords - 1); });
+        expect(rc == 0, test, "producer failed with exit code " + std::to_string(rc));
+
+        CollectSink out;
+        size_t n = reader.drain(out);
+        expect(n > 0 && n < (size_t)kRecords, test, "drained " + std::to_string(n) + " records");
+        expect(out.lines == range(0, (int)n - 1), test, "kept records are not the oldest, in order");
+        expect(n + reader.droppedCount() == (size_t)kRecords, test, "drained + dropped = " + std::to_string(n + reader.droppedCount()));
+        expect(reader.generation() == 1, test, "taking over the ring changed the generation");
+    }
+
+    void testRecreated(const std::string &name, ShmRingReader &reader)
+    {
+        const char *test = "recreated ring";
+        // 大小不同的环被重新创建: 新的共享内存对象，丢弃计数从0开始
+        int rc = runProducer([&]()
+                             {
+                                 ShmRingSink sink(name, 128 * 1024);
+                                 writeRecords(sink, 0, 9); });
+        expect(rc == 0, test, "producer failed with exit code " + std::to_string(rc));
+
+        CollectSink out;
+        size_t n = reader.drain(out);
+        expect(n == 10 && out.lines == range(0, 9), test, "drained " + std::to_string(n) + " records");
+        expect(reader.generation() == 2, test, "generation " + std::to_string(reader.generation()) + ", expected 2");
+        expect(reader.droppedCount() == 0, test, "dropped count carried over from the old ring");
+    }
+}
+#endif
+
+int main()
+{
+#if defined(_WIN32) || defined(_WIN64)
+    std::cout << "shared-memory rings are only supported on POSIX systems, skipped" << std::endl;
+    return 0;
+#else
+    std::string name = "test-" + std::to_string(getpid());
+    shm_unlink(ShmRingSink::shmName(name).c_str());
+
+    ShmRingReader reader(name);
+    testCrashedProducer(name, reader);
+    testDroppedThenTakenOver(name, reader);
+    testRecreated(name, reader);
+    shm_unlink(ShmRingSink::shmName(name).c_str());
+
+    if (failures)
+    {
+        std::cerr << failures << " check(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << "all shared-memory ring checks passed" << std::endl;
+    return 0;
+#endif
+}
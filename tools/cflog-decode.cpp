@@ -0,0 +1,59 @@
+/**
+ * @file cflog-decode.cpp
+ * @author Genleung Lan (genleung@hotmail.com)
+ * @brief 把二进制log(LOG*_BIN宏的输出，或以-r指定的BinaryRecordEncoder的输出)转为文本log
+ * @version 0.1
+ * @date 2021-07-31
+ * 
+ * @copyright Copyright (c) 2021
+ * 
+ */
+
+#include "Log.h"
+#include <fstream>
+#include <iostream>
+#include <string>
+
+using namespace cf::utils;
+
+int main(int argc, char *argv[])
+{
+    // -r: 输入为BinaryRecordEncoder的输出
+    bool records = argc > 1 && std::string(argv[1]) == "-r";
+    if (records)
+    {
+        argv++;
+        argc--;
+    }
+    if (argc < 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " [-r] <binary log file> [text log file]" << std::endl;
+        return 1;
+    }
+
+    std::ifstream in(argv[1], std::ios::binary);
+    if (!in)
+    {
+        std::cerr << "Cannot open " << argv[1] << std::endl;
+        return 1;
+    }
+
+    std::ofstream ofs;
+    if (argc > 2)
+    {
+        ofs.open(argv[2]);
+        if (!ofs)
+        {
+            std::cerr << "Cannot open " << argv[2] << std::endl;
+            return 1;
+        }
+    }
+
+    std::ostream &out = argc > 2 ? ofs : std::cout;
+    if (!(records ? BinaryRecordReader::decode(in, out) : BinaryLog::decode(in, out)))
+    {
+        std::cerr << argv[1] << ": truncated or not a cfLog binary log" << std::endl;
+        return 2;
+    }
+    return 0;
+}
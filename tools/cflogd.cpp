@@ -0,0 +1,132 @@
+/**
+ * @file cflogd.cpp
+ * @author Genleung Lan (genleung@hotmail.com)
+ * @brief log收集进程: 读出各生产者进程的共享内存环形缓冲区(ShmRingSink)，写入文件并滚动、压缩
+ * @version 0.1
+ * @date 2021-07-31
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#include "Log.h"
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+using namespace cf::utils;
+
+namespace
+{
+    volatile std::sig_atomic_t g_stop = 0;
+
+    void onSignal(int)
+    {
+        g_stop = 1;
+    }
+
+    void usage(const char *prog)
+    {
+        std::cerr << "Usage: " << prog << " [options] <log file> <ring name>..." << std::endl
+                  << "  -s <bytes>   rotate when the file exceeds <bytes>" << std::endl
+                  << "  -n <count>   keep at most <count> rotated files" << std::endl
+                  << "  -d           also rotate daily" << std::endl
+                  << "  -z           gzip rotated files" << std::endl
+                  << "  -i <ms>      poll interval when all rings are empty (default 5)" << std::endl;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+#if defined(_WIN32) || defined(_WIN64)
+    std::cerr << argv[0] << ": shared-memory rings are only supported on POSIX systems" << std::endl;
+    return 1;
+#else
+    RotationOptions options;
+    int intervalMs = 5;
+    int i = 1;
+    for (; i < argc && argv[i][0] == '-'; i++)
+    {
+        const char *opt = argv[i];
+        bool hasValue = !std::strcmp(opt, "-s") || !std::strcmp(opt, "-n") || !std::strcmp(opt, "-i");
+        if (hasValue && i + 1 >= argc)
+        {
+            usage(argv[0]);
+            return 1;
+        }
+        if (!std::strcmp(opt, "-s"))
+            options.maxBytes = (size_t)std::strtoull(argv[++i], nullptr, 10);
+        else if (!std::strcmp(opt, "-n"))
+            options.maxFiles = (size_t)std::strtoull(argv[++i], nullptr, 10);
+        else if (!std::strcmp(opt, "-i"))
+            intervalMs = std::atoi(argv[++i]);
+        else if (!std::strcmp(opt, "-d"))
+            options.interval = RotationInterval::DAILY;
+        else if (!std::strcmp(opt, "-z"))
+            options.compression = Compression::GZIP;
+        else
+        {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (argc - i < 2)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    RotatingFileSink sink(argv[i++], options, true);
+    std::vector<std::unique_ptr<ShmRingReader>> readers;
+    std::vector<uint64_t> reported;
+    std::vector<unsigned> generations;
+    for (; i < argc; i++)
+    {
+        readers.emplace_back(new ShmRingReader(argv[i]));
+        reported.push_back(0);
+        generations.push_back(0);
+    }
+
+    std::signal(SIGINT, onSignal);
+    std::signal(SIGTERM, onSignal);
+
+    // 收到SIGINT/SIGTERM后再读一轮，写完已提交的记录再退出
+    bool stopping = false;
+    while (!stopping)
+    {
+        stopping = g_stop != 0;
+        size_t written = 0;
+        for (size_t r = 0; r < readers.size(); r++)
+        {
+            written += readers[r]->drain(sink);
+
+            // 生产者重新创建了环: 新环的丢弃计数从0开始，已报告的数目随之归零
+            if (readers[r]->generation() != generations[r])
+            {
+                generations[r] = readers[r]->generation();
+                reported[r] = 0;
+            }
+
+            // 生产者因缓冲区已满而丢弃的记录: 写一条警告(解除映射期间计数保持不变)
+            uint64_t dropped = readers[r]->droppedCount();
+            if (dropped > reported[r])
+            {
+                std::string line = "[W][cflogd] ring " + readers[r]->name() + ": " + std::to_string(dropped - reported[r]) + " records dropped";
+                sink.write(LogLevel::WARN, line.data(), line.size());
+                written++;
+            }
+            reported[r] = dropped;
+        }
+
+        if (written)
+            sink.flush();
+        else if (!stopping)
+            std::this_thread::sleep_for(std::chrono::milliseconds(intervalMs));
+    }
+    sink.flush();
+    return 0;
+#endif
+}